@@ -0,0 +1,158 @@
+/*
+ * 3D Flight Shooter - portrait atlas loader
+ * Author: Matus Vecera
+ *
+ * See atlas.h. The whole file is mapped once and checked, after that looking
+ * up a portrait is a scan of a dozen names and drawing it reads the mapping.
+ * The game opens it on a worker thread (atlas_load_start) when you win.
+ */
+
+#define _XOPEN_SOURCE 600 // for mmap and posix_madvise
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "atlas.h"
+
+// Map the atlas file, returns 0 (and leaves the atlas empty) if it is missing or broken
+int atlas_open(Atlas *atlas, const char *path) {
+    struct stat st;
+    const AtlasHeader *h;
+    const AtlasRect *r;
+    size_t table, need;
+    unsigned int i;
+    void *map;
+    int fd;
+    
+    memset(atlas, 0, sizeof(*atlas));
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(AtlasHeader)) { close(fd); return 0; }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping stays valid after close
+    if (map == MAP_FAILED) return 0;
+    
+    // Check the header and that the table and pixels really fit in the file
+    h = map;
+    table = sizeof(AtlasHeader) + (size_t)h->count * sizeof(AtlasRect);
+    need = table + (size_t)h->width * h->height * 3;
+    if (memcmp(h->magic, ATLAS_MAGIC, 4) != 0 || need > (size_t)st.st_size) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+    
+    // ...and that every portrait lies inside the atlas image, drawing one reads it without checks
+    r = (const AtlasRect *)(h + 1);
+    for (i = 0; i < h->count; i++) {
+        if ((unsigned int)r[i].x + r[i].w > h->width || (unsigned int)r[i].y + r[i].h > h->height) {
+            munmap(map, st.st_size);
+            return 0;
+        }
+    }
+    
+    atlas->header = h;
+    atlas->rects = (const AtlasRect *)(h + 1);
+    atlas->pixels = (const unsigned char *)map + table;
+    atlas->size = st.st_size;
+    return 1;
+}
+
+// Rect of the portrait with this name, NULL if it was not packed
+const AtlasRect *atlas_find(const Atlas *atlas, const char *name) {
+    unsigned int i;
+    
+    if (!atlas->header) return NULL;
+    for (i = 0; i < atlas->header->count; i++) {
+        if (strncmp(atlas->rects[i].name, name, ATLAS_NAME_LEN) == 0) return &atlas->rects[i];
+    }
+    return NULL;
+}
+
+void atlas_close(Atlas *atlas) {
+    if (atlas->header) munmap((void *)atlas->header, atlas->size);
+    memset(atlas, 0, sizeof(*atlas));
+}
+
+/* ==================== LOADING ON A WORKER THREAD ==================== */
+
+// Open the atlas, ask the kernel to start reading all of it, then fault in every
+// portrait's pages one rect at a time (one byte per page, from its first row to its
+// last) and publish how many are in. Checks stop between portraits so quitting does
+// not wait for it.
+void *atlas_load_worker(void *arg) {
+    AtlasLoader *loader = arg;
+    Atlas atlas;
+    const AtlasRect *r;
+    const volatile unsigned char *p, *end;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE), row;
+    unsigned int i, total = 0;
+    int stop = 0;
+    
+    if (atlas_open(&atlas, loader->path)) {
+        total = atlas.header->count;
+        posix_madvise((void *)atlas.header, atlas.size, POSIX_MADV_WILLNEED);
+    }
+    pthread_mutex_lock(&loader->lock);
+    loader->atlas = atlas;
+    loader->total = (int)total;
+    pthread_mutex_unlock(&loader->lock);
+    
+    for (i = 0; i < total && !stop; i++) {
+        r = &atlas.rects[i];
+        if (r->w > 0 && r->h > 0) {
+            row = (size_t)atlas.header->width * 3;
+            p = atlas.pixels + (size_t)r->y * row + (size_t)r->x * 3;
+            end = p + (size_t)(r->h - 1) * row + (size_t)r->w * 3;
+            for (; p < end; p += page) (void)*p;
+            (void)end[-1];
+        }
+        pthread_mutex_lock(&loader->lock);
+        loader->ready = (int)i + 1;
+        stop = loader->stop;
+        pthread_mutex_unlock(&loader->lock);
+    }
+    
+    pthread_mutex_lock(&loader->lock);
+    loader->done = 1;
+    pthread_mutex_unlock(&loader->lock);
+    return NULL;
+}
+
+// Start loading in the background, does nothing if it was started before
+// (a restarted game that wins again reuses what is already loaded)
+void atlas_load_start(AtlasLoader *loader, const char *path) {
+    if (loader->started) return;
+    memset(loader, 0, sizeof(*loader));
+    loader->path = path;
+    loader->started = 1;
+    pthread_mutex_init(&loader->lock, NULL);
+    if (pthread_create(&loader->thread, NULL, atlas_load_worker, loader) != 0) {
+        atlas_load_worker(loader); // no thread, load it right here instead
+        loader->started = 2;       // ...and there is nothing to join
+    }
+}
+
+// How far it got: portraits ready and in the atlas, returns 1 once it is finished
+int atlas_load_status(AtlasLoader *loader, int *ready, int *total) {
+    int done;
+    
+    pthread_mutex_lock(&loader->lock);
+    *ready = loader->ready;
+    *total = loader->total;
+    done = loader->done;
+    pthread_mutex_unlock(&loader->lock);
+    return done;
+}
+
+// Stop the worker (if it is still going), wait for it and close the atlas
+void atlas_load_stop(AtlasLoader *loader) {
+    if (!loader->started) return;
+    pthread_mutex_lock(&loader->lock);
+    loader->stop = 1;
+    pthread_mutex_unlock(&loader->lock);
+    if (loader->started == 1) pthread_join(loader->thread, NULL);
+    pthread_mutex_destroy(&loader->lock);
+    atlas_close(&loader->atlas);
+    loader->started = 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * 3D Flight Shooter - portrait atlas
+ * Author: Matus Vecera
+ *
+ * All win screen portraits packed into one file by packatlas at build time:
+ *
+ *   AtlasHeader                      magic, rect count, atlas image size
+ *   AtlasRect[count]                 where each portrait sits, keyed by name
+ *   width * height * 3 bytes         RGB pixels of the atlas image
+ *
+ * The portraits are already resampled to the size the win screen draws them at,
+ * so the game maps the file and copies pixels straight out of it. The file is
+ * written in the build machine's byte order, it is rebuilt with the game.
+ */
+
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <stddef.h> // for size_t
+#include <pthread.h>
+
+#define ATLAS_MAGIC "ATL1"
+#define ATLAS_NAME_LEN 20 // portrait name (file name without .ppm), 0-terminated
+
+typedef struct {
+    char magic[4];
+    unsigned int count;          // rects in the table
+    unsigned int width, height;  // atlas image size in pixels
+} AtlasHeader;
+
+typedef struct {
+    char name[ATLAS_NAME_LEN];
+    unsigned short x, y, w, h;   // place in the atlas image
+} AtlasRect;
+
+// A loaded atlas, everything points into one read-only mapping of the file
+typedef struct {
+    const AtlasHeader *header;   // NULL = not loaded
+    const AtlasRect *rects;
+    const unsigned char *pixels;
+    size_t size;                 // bytes mapped
+} Atlas;
+
+// Opens an atlas on a worker thread and touches each portrait's pages in table
+// order (the first touch of a mapped page is the slow part), so the win screen
+// can show the portraits one by one as they arrive instead of freezing
+typedef struct {
+    Atlas atlas;                 // set by the worker before the first portrait is ready
+    const char *path;
+    int ready;                   // rects read so far, rects[0 .. ready-1] can be drawn
+    int total;                   // rects in the atlas, 0 if it is missing or broken
+    int done;                    // 1 = the worker has finished
+    int stop;                    // set to make the worker give up early
+    int started;
+    pthread_mutex_t lock;        // guards ready, total, done and stop
+    pthread_t thread;
+} AtlasLoader;
+
+int atlas_open(Atlas *atlas, const char *path);
+const AtlasRect *atlas_find(const Atlas *atlas, const char *name);
+void atlas_close(Atlas *atlas);
+void atlas_load_start(AtlasLoader *loader, const char *path);
+int atlas_load_status(AtlasLoader *loader, int *ready, int *total);
+void atlas_load_stop(AtlasLoader *loader);
+
+#endif
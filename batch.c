@@ -0,0 +1,395 @@
+/*
+ * 3D Flight Shooter - headless batch runner
+ * Author: Matus Vecera
+ *
+ * Plays many games with a bot, no window and no drawing, to see how hard the
+ * game is and what changing the difficulty knobs does. Every session is seeded
+ * (seed, seed+1, ...) so any result can be played again, and the sessions are
+ * shared out over a pool of threads (one per core by default).
+ *
+ * Usage: ./batch [-n sessions] [-j threads] [-s seed] [-m max_frames]
+ *                [-r chunk_cubes] [-h hit_scale] [-p player_radius] [-v speed] [-q]
+ *        ./batch -L frames     long flight, checks that origin rebasing keeps
+ *                              positions, terrain and collisions where they belong
+ *                              (make longflight runs it in the double and float32 builds)
+ */
+
+#define _XOPEN_SOURCE 500 // for getopt and sysconf
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "project.h"
+
+#define SIM_FPS 80 // the interactive game runs at about 80 frames/sec, used to turn frames into seconds
+#define DEFAULT_SESSIONS 64
+#define DEFAULT_MAX_FRAMES (5 * 60 * SIM_FPS) // give up after 5 minutes of game time
+#define MAX_THREADS 64
+
+// Outcome of one bot game
+typedef struct {
+    unsigned int seed;
+    int result;     // SIM_WON, SIM_LOST, or SIM_PLAYING if it ran out of frames
+    int crashed;    // 1 = lost by hitting the ground, not by running out of lives
+    int frames;     // frames simulated
+    int score;
+    int deaths;     // lives lost, a ground crash counts as one
+    int shots;      // bullets fired
+} Session;
+
+// Work shared by the thread pool: each thread takes the next unplayed session
+typedef struct {
+    Session *sessions;
+    int count;
+    int next;              // next session to hand out
+    pthread_mutex_t lock;  // protects next
+    Tuning tuning;
+    int max_frames;
+} Batch;
+
+/* ==================== BOT ==================== */
+
+// Keep an angle between -PI and PI
+double wrap_angle(double a) {
+    while (a > PI) a -= 2.0 * PI;
+    while (a < -PI) a += 2.0 * PI;
+    return a;
+}
+
+// Bot policy: turn toward the nearest cube in front and shoot once lined up,
+// otherwise weave like the renderer's scripted flight. Never fly lower than
+// 60 units over the ground a little way ahead. Returns 1 to fire this frame.
+int bot_frame(GameState *game, int frame, int *mx, int *my) {
+    Camera *cam = &game->camera;
+    Obstacle *obs, *target = NULL;
+    double dx, dz, distSq, bestSq = 1000.0 * 1000.0;
+    double yaw_err = 0.0, want_pitch, ground;
+    int i, dx_mouse, dy_mouse, fire = 0;
+    
+    for (i = 0; i < game->chunks.live_count; i++) {
+        obs = &game->obstacles[game->chunks.live[i]];
+        if (!obs->active) continue;
+        dx = obs->position.x - cam->position.x;
+        dz = obs->position.z - cam->position.z;
+        if (dx * cam->sin_yaw + dz * cam->cos_yaw < 50.0) continue; // behind or too close to turn
+        distSq = dx * dx + dz * dz;
+        if (distSq < bestSq) {
+            bestSq = distSq;
+            target = obs;
+        }
+    }
+    
+    if (target) {
+        dx = target->position.x - cam->position.x;
+        dz = target->position.z - cam->position.z;
+        yaw_err = wrap_angle(atan2(dx, dz) - cam->yaw);
+        want_pitch = atan2(target->position.y - cam->position.y, sqrt(bestSq));
+        dx_mouse = (int)(yaw_err * 2000.0);
+        fire = fabs(yaw_err) < 0.04 && fabs(want_pitch - cam->pitch) < 0.06 && frame % 6 == 0;
+    } else {
+        ground = get_terrain_height(game, cam->position.x, cam->position.z);
+        want_pitch = (ground + 120.0 - cam->position.y) * 0.004;
+        dx_mouse = (int)(150.0 * sin(frame * 0.01));
+    }
+    
+    // Terrain check 60 units ahead, climb if it is too close
+    ground = get_terrain_height(game, cam->position.x + 60.0 * cam->sin_yaw, cam->position.z + 60.0 * cam->cos_yaw);
+    if (cam->position.y < ground + 60.0 && want_pitch < 0.2) want_pitch = 0.2;
+    
+    if (want_pitch > 0.3) want_pitch = 0.3;
+    if (want_pitch < -0.3) want_pitch = -0.3;
+    dy_mouse = (int)((want_pitch - cam->pitch) * 3000.0);
+    
+    if (dx_mouse > SCREEN_CX) dx_mouse = SCREEN_CX;
+    if (dx_mouse < -SCREEN_CX) dx_mouse = -SCREEN_CX;
+    if (dy_mouse > SCREEN_CY) dy_mouse = SCREEN_CY;
+    if (dy_mouse < -SCREEN_CY) dy_mouse = -SCREEN_CY;
+    *mx = SCREEN_CX + dx_mouse;
+    *my = SCREEN_CY + dy_mouse;
+    return fire;
+}
+
+/* ==================== SESSIONS ==================== */
+
+// Play one game with the bot until it is won, lost or out of frames
+void run_session(Batch *batch, Session *s) {
+    GameState game;
+    int frame, mx, my, result = SIM_PLAYING;
+    
+    memset(&game, 0, sizeof(game)); // display settings are never used here
+    game.tuning = batch->tuning;
+    seed_game(&game, s->seed);
+    init_game(&game);
+    update_camera_trig(&game.camera);
+    
+    for (frame = 0; frame < batch->max_frames && result == SIM_PLAYING; frame++) {
+        if (bot_frame(&game, frame, &mx, &my)) {
+            fire_bullet(&game);
+            s->shots++;
+        }
+        result = simulate_frame(&game, mx, my);
+        s->deaths += game.events.collisions + game.events.crashed;
+        if (game.events.crashed) s->crashed = 1;
+    }
+    s->result = result;
+    s->frames = frame;
+    s->score = game.score;
+}
+
+// Thread pool worker: keep taking sessions until there are none left
+void *batch_worker(void *arg) {
+    Batch *batch = arg;
+    int i;
+    
+    while (1) {
+        pthread_mutex_lock(&batch->lock);
+        i = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+        if (i >= batch->count) break;
+        run_session(batch, &batch->sessions[i]);
+    }
+    return NULL;
+}
+
+// Short name for how a session ended
+const char *result_name(Session *s) {
+    if (s->result == SIM_WON) return "won";
+    if (s->result == SIM_PLAYING) return "timeout";
+    return s->crashed ? "crashed" : "out of lives";
+}
+
+/* ==================== LONG FLIGHT (REBASE CHECK) ==================== */
+// ./batch -L frames flies a straight line at top speed from far out, where float32 is
+// coarse, with a cube planted in the way every LONG_PLANT_EVERY frames and one to shoot
+// halfway between. Two flights run side by side, one rebasing the origin like the game
+// does and one never rebasing, and both are measured against the exact line worked out
+// in double: camera position, the terrain height under it, and whether every planted
+// hit and collision registers. The rebased flight must stay within the tolerance.
+
+#define LONG_SPEED 10.0      // top speed (the + key stops there)
+#define LONG_START 1.0e6     // world x and z the flight starts from
+#define LONG_YAW 0.6         // heading, so both x and z keep changing
+#define LONG_PLANT_EVERY 100 // frames between planted collisions
+#define LONG_CUBE_SIZE 30.0
+#define LONG_DRIFT_DOUBLE 1e-12 // position error allowed per unit flown (adding up small steps is never exact)
+#define LONG_DRIFT_FLOAT 1e-5
+#define LONG_HEIGHT_DOUBLE 1e-6 // terrain height error allowed (the phases are reduced mod 2*PI)
+#define LONG_HEIGHT_FLOAT 1e-2
+
+typedef struct {
+    GameState game;
+    double max_error;     // furthest the camera got from the exact line
+    double max_height;    // largest terrain height error under the camera
+    int hits, collisions; // planted ones that registered
+} LongFlight;
+
+// Exact terrain height at a world position (the formula get_terrain_height evaluates
+// with the origin folded into its phases)
+double exact_height(double wx, double wz) {
+    return 30.0 * sin(wx * 0.01) * sin(wz * 0.01) + 15.0 * sin(wx * 0.03 + wz * 0.02);
+}
+
+// Same game for both flights, the only difference is rebasing
+void long_start(LongFlight *f, int rebase) {
+    GameState *game = &f->game;
+    
+    memset(f, 0, sizeof(*f));
+    default_tuning(game);
+    game->tuning.chunk_cubes = 0; // only the planted cubes
+    game->tuning.start_speed = LONG_SPEED;
+    if (!rebase) game->tuning.rebase_distance = 0.0;
+    seed_game(game, 1);
+    init_game(game);
+    game->lives = 1000000;
+    game->show_Win_Screen = 1; // keep flying past WIN_SCORE
+    game->camera.yaw = LONG_YAW;
+    if (rebase) {
+        set_origin(game, LONG_START, LONG_START);
+    } else {
+        game->camera.position.x = LONG_START;
+        game->camera.position.z = LONG_START;
+    }
+    update_camera_trig(&game->camera);
+    reload_chunks(game);
+}
+
+// Put cube k of the chunk under the camera at world (wx, wz), level with the camera
+// That chunk stays loaded until long after the cube is shot or flown into
+void plant_cube(GameState *game, int k, double wx, double wz) {
+    int cx = (int)floor((game->origin_x + game->camera.position.x) / CHUNK_SIZE);
+    int cz = (int)floor((game->origin_z + game->camera.position.z) / CHUNK_SIZE);
+    int j = chunk_slot(cx, cz) * CHUNK_CUBES_MAX + k, i;
+    Obstacle *obs = &game->obstacles[j];
+    
+    obs->active = 1;
+    obs->position.x = wx - game->origin_x;
+    obs->position.z = wz - game->origin_z;
+    obs->position.y = game->camera.position.y;
+    obs->size = LONG_CUBE_SIZE;
+    obs->rotation = 0.0;
+    for (i = 0; i < game->chunks.live_count && game->chunks.live[i] != j; i++) ;
+    if (i == game->chunks.live_count) game->chunks.live[game->chunks.live_count++] = (short)j;
+}
+
+// One frame of one flight, (wx, wz) = where the exact line is at the start of the frame
+// and (dx, dz) = its direction
+void long_frame(LongFlight *f, int frame, double wx, double wz, double dx, double dz) {
+    GameState *game = &f->game;
+    double ex, ez, err;
+    
+    if (frame % LONG_PLANT_EVERY == 0) {
+        plant_cube(game, 0, wx + 45.0 * dx, wz + 45.0 * dz); // flown into this frame
+    }
+    if (frame % LONG_PLANT_EVERY == LONG_PLANT_EVERY / 2) {
+        plant_cube(game, 1, wx + 310.0 * dx, wz + 310.0 * dz); // the bullet gets there 19 frames later
+        fire_bullet(game);
+    }
+    simulate_frame(game, SCREEN_CX, SCREEN_CY);
+    f->hits += game->events.hits;
+    f->collisions += game->events.collisions;
+    
+    ex = game->origin_x + game->camera.position.x - (LONG_START + (frame + 1) * LONG_SPEED * dx);
+    ez = game->origin_z + game->camera.position.z - (LONG_START + (frame + 1) * LONG_SPEED * dz);
+    err = sqrt(ex * ex + ez * ez);
+    if (err > f->max_error) f->max_error = err;
+    err = fabs(get_terrain_height(game, game->camera.position.x, game->camera.position.z) -
+               exact_height(game->origin_x + game->camera.position.x, game->origin_z + game->camera.position.z));
+    if (err > f->max_height) f->max_height = err;
+}
+
+// Returns 0 if the rebased flight stayed within the tolerance and registered everything, 2 if not
+int long_flight(int frames) {
+    static LongFlight flights[2]; // rebased, never rebased (too big for the stack)
+    static const char *names[2] = {"rebased", "never rebased"};
+    int single = sizeof(real) == sizeof(float);
+    double drift, height = single ? LONG_HEIGHT_FLOAT : LONG_HEIGHT_DOUBLE;
+    double wx, wz, dx, dz;
+    int frame, i, planted, disagree = 0, ok;
+    
+    frames = (frames + LONG_PLANT_EVERY - 1) / LONG_PLANT_EVERY * LONG_PLANT_EVERY; // whole plant cycles
+    planted = frames / LONG_PLANT_EVERY;
+    drift = frames * LONG_SPEED * (single ? LONG_DRIFT_FLOAT : LONG_DRIFT_DOUBLE);
+    for (i = 0; i < 2; i++) long_start(&flights[i], i == 0);
+    // The exact line moves by what the game adds each frame (its own sin/cos, in real),
+    // multiplied out instead of added up, so what is measured is the error of adding it up
+    dx = flights[0].game.camera.sin_yaw * flights[0].game.camera.cos_pitch;
+    dz = flights[0].game.camera.cos_yaw * flights[0].game.camera.cos_pitch;
+    
+    for (frame = 0; frame < frames; frame++) {
+        wx = LONG_START + frame * LONG_SPEED * dx;
+        wz = LONG_START + frame * LONG_SPEED * dz;
+        for (i = 0; i < 2; i++) long_frame(&flights[i], frame, wx, wz, dx, dz);
+        if (flights[0].game.events.hits != flights[1].game.events.hits ||
+            flights[0].game.events.collisions != flights[1].game.events.collisions) disagree++;
+    }
+    
+    printf("Long flight: %d frames at speed %.0f from (%.0f, %.0f), %.0f units, positions in %s\n", frames,
+           LONG_SPEED, LONG_START, LONG_START, frames * LONG_SPEED, single ? "float32" : "double");
+    printf("%-14s %13s %13s %12s %12s\n", "", "max position", "max height", "hits", "collisions");
+    for (i = 0; i < 2; i++) {
+        printf("%-14s %13.3g %13.3g %5d of %-4d %5d of %-4d\n", names[i], flights[i].max_error, flights[i].max_height,
+               flights[i].hits, planted, flights[i].collisions, planted);
+    }
+    printf("Frames where the two flights disagree on a hit or collision: %d\n", disagree);
+    
+    ok = flights[0].max_error <= drift && flights[0].max_height <= height &&
+         flights[0].hits == planted && flights[0].collisions == planted;
+    printf("Rebased flight %s (allowed: position %.3g, height %.3g, every hit and collision)\n",
+           ok ? "OK" : "FAILED", drift, height);
+    return ok ? 0 : 2;
+}
+
+/* ==================== MAIN FUNCTION ==================== */
+
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-n sessions] [-j threads] [-s seed] [-m max_frames]\n", prog);
+    fprintf(stderr, "          [-r chunk_cubes] [-h hit_scale] [-p player_radius] [-v speed] [-q]\n");
+    fprintf(stderr, "  -n sessions       games to play (default %d)\n", DEFAULT_SESSIONS);
+    fprintf(stderr, "  -j threads        worker threads (default: one per core)\n");
+    fprintf(stderr, "  -s seed           seed of the first game, the others use seed+1, seed+2, ... (default 1)\n");
+    fprintf(stderr, "  -m max_frames     stop a game after this many frames (default %d)\n", DEFAULT_MAX_FRAMES);
+    fprintf(stderr, "  -r chunk_cubes    each %dx%d chunk of the world holds 0 to chunk_cubes cubes, at most %d (default 2)\n",
+            CHUNK_SIZE, CHUNK_SIZE, CHUNK_CUBES_MAX);
+    fprintf(stderr, "  -h hit_scale      bullet hit radius as a multiple of cube size (default 1.0)\n");
+    fprintf(stderr, "  -p player_radius  added to cube size when flying into it (default 20)\n");
+    fprintf(stderr, "  -v speed          starting speed (default %.1f)\n", START_SPEED);
+    fprintf(stderr, "  -q                only print the summary\n");
+    fprintf(stderr, "  -L frames         no games: fly frames frames far out, rebased and not, and check the rebased one\n");
+}
+
+int main(int argc, char *argv[]) {
+    GameState defaults;
+    Batch batch;
+    Session *s;
+    pthread_t threads[MAX_THREADS];
+    unsigned int seed = 1;
+    int threads_n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int quiet = 0, opt, i;
+    int won = 0, crashed = 0, out_of_lives = 0, timeouts = 0;
+    long total_frames = 0, total_score = 0, total_deaths = 0, won_frames = 0;
+    double t_start, elapsed;
+    
+    default_tuning(&defaults);
+    memset(&batch, 0, sizeof(batch));
+    batch.tuning = defaults.tuning;
+    batch.count = DEFAULT_SESSIONS;
+    batch.max_frames = DEFAULT_MAX_FRAMES;
+    while ((opt = getopt(argc, argv, "n:j:s:m:r:h:p:v:qL:")) != -1) {
+        if (opt == 'n') batch.count = atoi(optarg);
+        else if (opt == 'j') threads_n = atoi(optarg);
+        else if (opt == 's') seed = (unsigned int)strtoul(optarg, NULL, 10);
+        else if (opt == 'm') batch.max_frames = atoi(optarg);
+        else if (opt == 'r') batch.tuning.chunk_cubes = atoi(optarg);
+        else if (opt == 'h') batch.tuning.hit_scale = atof(optarg);
+        else if (opt == 'p') batch.tuning.player_radius = atof(optarg);
+        else if (opt == 'v') batch.tuning.start_speed = atof(optarg);
+        else if (opt == 'q') quiet = 1;
+        else if (opt == 'L') return long_flight(atoi(optarg));
+        else { usage(argv[0]); return 1; }
+    }
+    if (batch.count < 1 || batch.tuning.chunk_cubes < 0 || batch.tuning.chunk_cubes > CHUNK_CUBES_MAX) { usage(argv[0]); return 1; }
+    if (threads_n < 1) threads_n = 1;
+    if (threads_n > MAX_THREADS) threads_n = MAX_THREADS;
+    if (threads_n > batch.count) threads_n = batch.count;
+    
+    batch.sessions = calloc(batch.count, sizeof(Session));
+    if (!batch.sessions) return 1;
+    for (i = 0; i < batch.count; i++) batch.sessions[i].seed = seed + i;
+    pthread_mutex_init(&batch.lock, NULL);
+    
+    t_start = now_seconds();
+    for (i = 0; i < threads_n; i++) pthread_create(&threads[i], NULL, batch_worker, &batch);
+    for (i = 0; i < threads_n; i++) pthread_join(threads[i], NULL);
+    elapsed = now_seconds() - t_start;
+    
+    if (!quiet) printf("%-10s %-13s %6s %8s %7s %6s\n", "seed", "result", "score", "time(s)", "deaths", "shots");
+    for (i = 0; i < batch.count; i++) {
+        s = &batch.sessions[i];
+        if (!quiet) {
+            printf("%-10u %-13s %6d %8.1f %7d %6d\n", s->seed, result_name(s), s->score,
+                   s->frames / (double)SIM_FPS, s->deaths, s->shots);
+        }
+        total_frames += s->frames;
+        total_score += s->score;
+        total_deaths += s->deaths;
+        if (s->result == SIM_WON) { won++; won_frames += s->frames; }
+        else if (s->result == SIM_PLAYING) timeouts++;
+        else if (s->crashed) crashed++;
+        else out_of_lives++;
+    }
+    
+    printf("\n%d sessions on %d threads: %ld frames in %.2f s = %.0f frames/sec\n",
+           batch.count, threads_n, total_frames, elapsed, total_frames / elapsed);
+    printf("Won %d (%.0f%%), crashed %d, out of lives %d, timed out %d\n",
+           won, 100.0 * won / batch.count, crashed, out_of_lives, timeouts);
+    printf("Average score %.0f, average deaths %.2f", (double)total_score / batch.count,
+           (double)total_deaths / batch.count);
+    if (won > 0) printf(", average time to win %.1f s", won_frames / (double)won / SIM_FPS);
+    printf("\n");
+    
+    pthread_mutex_destroy(&batch.lock);
+    free(batch.sessions);
+    return 0;
+}
@@ -0,0 +1,410 @@
+/*
+A simple graphics library for CSE 20311,
+originally created by Prof. Douglas Thain.
+
+Kept in the project as source (instead of only gfx.o) so it can grow the
+calls the game needs: gfx_poll hands out every event with its X timestamp,
+and pointer motion is delivered so steering no longer needs a key held down.
+*/
+
+#include <X11/Xlib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gfx.h"
+#include "gfx_font.h"
+
+/*
+gfx_open creates several X11 objects, and stores them in globals
+for use by the other functions in the library.
+*/
+
+static Display *gfx_display=0;
+static Window  gfx_window;
+static GC      gfx_gc;
+static Colormap gfx_colormap;
+static int      gfx_fast_color_mode = 0;
+
+/* These values are saved by gfx_wait then retrieved later by gfx_xpos and gfx_ypos. */
+
+static int saved_xpos = 0;
+static int saved_ypos = 0;
+
+/* Window size and the work counted for gfx_counters. */
+
+static int gfx_width = 0;
+static int gfx_height = 0;
+static int count_lines = 0;
+static int count_offscreen = 0;
+static int count_points = 0;
+static int count_colors = 0;
+
+/* Drawing rectangle set by gfx_clip (x0,y0 inclusive, x1,y1 exclusive). */
+
+static int clip_x0 = 0, clip_y0 = 0, clip_x1 = 0, clip_y1 = 0;
+
+/* Open a new graphics window. */
+
+void gfx_open( int width, int height, const char *title )
+{
+	gfx_display = XOpenDisplay(0);
+	if(!gfx_display) {
+		fprintf(stderr,"gfx_open: unable to open the graphics window.\n");
+		exit(1);
+	}
+
+	Visual *visual = DefaultVisual(gfx_display,0);
+	if(visual && visual->class==TrueColor) {
+		gfx_fast_color_mode = 1;
+	} else {
+		gfx_fast_color_mode = 0;
+	}
+
+	int blackColor = BlackPixel(gfx_display, DefaultScreen(gfx_display));
+	int whiteColor = WhitePixel(gfx_display, DefaultScreen(gfx_display));
+
+	gfx_width = width;
+	gfx_height = height;
+	clip_x1 = width;
+	clip_y1 = height;
+
+	gfx_window = XCreateSimpleWindow(gfx_display, DefaultRootWindow(gfx_display), 0, 0, width, height, 0, blackColor, blackColor);
+
+	XSetWindowAttributes attr;
+	attr.backing_store = Always;
+
+	XChangeWindowAttributes(gfx_display,gfx_window,CWBackingStore,&attr);
+
+	XStoreName(gfx_display,gfx_window,title);
+
+	XSelectInput(gfx_display, gfx_window, StructureNotifyMask|KeyPressMask|ButtonPressMask|PointerMotionMask);
+
+	XMapWindow(gfx_display,gfx_window);
+
+	gfx_gc = XCreateGC(gfx_display, gfx_window, 0, 0);
+
+	gfx_colormap = DefaultColormap(gfx_display,0);
+
+	XSetForeground(gfx_display, gfx_gc, whiteColor);
+
+	/* Wait for the MapNotify event */
+
+	for(;;) {
+		XEvent e;
+		XNextEvent(gfx_display, &e);
+		if (e.type == MapNotify)
+			break;
+	}
+}
+
+/* Draw a single point at (x,y) */
+
+void gfx_point( int x, int y )
+{
+	XDrawPoint(gfx_display,gfx_window,gfx_gc,x,y);
+}
+
+/* Draw a line from (x1,y1) to (x2,y2) */
+
+void gfx_line( int x1, int y1, int x2, int y2 )
+{
+	count_lines++;
+	count_points += 2;
+	if((x1<clip_x0 && x2<clip_x0) || (x1>=clip_x1 && x2>=clip_x1) || (y1<clip_y0 && y2<clip_y0) || (y1>=clip_y1 && y2>=clip_y1)) {
+		count_offscreen++;
+	}
+	XDrawLine(gfx_display,gfx_window,gfx_gc,x1,y1,x2,y2);
+}
+
+/* Draw n separate lines in as few requests as possible (XDrawSegments). */
+/* XSegment holds shorts, so far-off endpoints are clamped to that range. */
+
+static short gfx_short( int v )
+{
+	if(v<-32768) return -32768;
+	if(v>32767) return 32767;
+	return v;
+}
+
+void gfx_segments( const int *xy, int n )
+{
+	XSegment seg[256];
+	int k = 0;
+
+	for(; n>0; n--, xy+=4) {
+		count_lines++;
+		count_points += 2;
+		if((xy[0]<clip_x0 && xy[2]<clip_x0) || (xy[0]>=clip_x1 && xy[2]>=clip_x1) || (xy[1]<clip_y0 && xy[3]<clip_y0) || (xy[1]>=clip_y1 && xy[3]>=clip_y1)) {
+			count_offscreen++;
+		}
+		seg[k].x1 = gfx_short(xy[0]);
+		seg[k].y1 = gfx_short(xy[1]);
+		seg[k].x2 = gfx_short(xy[2]);
+		seg[k].y2 = gfx_short(xy[3]);
+		if(++k == 256) {
+			XDrawSegments(gfx_display,gfx_window,gfx_gc,seg,k);
+			k = 0;
+		}
+	}
+	if(k>0) XDrawSegments(gfx_display,gfx_window,gfx_gc,seg,k);
+}
+
+/* Draw a connected line through n points (XDrawLines), every point is sent once. */
+/* Long ones go out in pieces that share their end point. */
+
+void gfx_polyline( const int *xy, int n )
+{
+	XPoint pts[256];
+	int i, k = 0;
+
+	if(n<2) return;
+	count_points += n;
+	for(i=0; i<n; i++, xy+=2) {
+		if(i>0) {
+			count_lines++;
+			if((xy[-2]<clip_x0 && xy[0]<clip_x0) || (xy[-2]>=clip_x1 && xy[0]>=clip_x1) || (xy[-1]<clip_y0 && xy[1]<clip_y0) || (xy[-1]>=clip_y1 && xy[1]>=clip_y1)) {
+				count_offscreen++;
+			}
+		}
+		pts[k].x = gfx_short(xy[0]);
+		pts[k].y = gfx_short(xy[1]);
+		if(++k == 256) {
+			XDrawLines(gfx_display,gfx_window,gfx_gc,pts,k,CoordModeOrigin);
+			pts[0] = pts[k-1];
+			k = 1;
+		}
+	}
+	if(k>1) XDrawLines(gfx_display,gfx_window,gfx_gc,pts,k,CoordModeOrigin);
+}
+
+/* Draw a circle centered at (xc,yc) with radius r */
+
+void gfx_circle( int xc, int yc, int r )
+{
+	XDrawArc(gfx_display,gfx_window,gfx_gc,xc-r,yc-r,2*r,2*r,0,360*64);
+}
+
+/* Change the current drawing color. */
+
+void gfx_color( int r, int g, int b )
+{
+	XColor color;
+
+	count_colors++;
+
+	if(gfx_fast_color_mode) {
+		/* If this is a truecolor display, we can just pick the color directly. */
+		color.pixel = ((b&0xff) | ((g&0xff)<<8) | ((r&0xff)<<16) );
+	} else {
+		/* Otherwise, we have to allocate it from the colormap of the display. */
+		color.pixel = 0;
+		color.red = r<<8;
+		color.green = g<<8;
+		color.blue = b<<8;
+		XAllocColor(gfx_display,gfx_colormap,&color);
+	}
+
+	XSetForeground(gfx_display, gfx_gc, color.pixel);
+}
+
+/* Clear the graphics window (or just the clip rectangle) to the background color. */
+
+void gfx_clear()
+{
+	if(clip_x0==0 && clip_y0==0 && clip_x1==gfx_width && clip_y1==gfx_height) {
+		XClearWindow(gfx_display,gfx_window);
+	} else {
+		XClearArea(gfx_display,gfx_window,clip_x0,clip_y0,clip_x1-clip_x0,clip_y1-clip_y0,False);
+	}
+}
+
+/* Only draw inside the w x h rectangle at (x,y), w or h <= 0 = the whole window again. */
+
+void gfx_clip( int x, int y, int w, int h )
+{
+	XRectangle rect;
+
+	if(w<=0 || h<=0) {
+		clip_x0 = clip_y0 = 0;
+		clip_x1 = gfx_width;
+		clip_y1 = gfx_height;
+		XSetClipMask(gfx_display,gfx_gc,None);
+		return;
+	}
+	clip_x0 = x;
+	clip_y0 = y;
+	clip_x1 = x+w;
+	clip_y1 = y+h;
+	rect.x = 0;
+	rect.y = 0;
+	rect.width = w;
+	rect.height = h;
+	XSetClipRectangles(gfx_display,gfx_gc,x,y,&rect,1,Unsorted);
+}
+
+/* Change the current background color. */
+
+void gfx_clear_color( int r, int g, int b )
+{
+	XColor color;
+	color.pixel = 0;
+	color.red = r<<8;
+	color.green = g<<8;
+	color.blue = b<<8;
+	XAllocColor(gfx_display,gfx_colormap,&color);
+
+	XSetWindowAttributes attr;
+	attr.background_pixel = color.pixel;
+	XChangeWindowAttributes(gfx_display,gfx_window,CWBackPixel,&attr);
+}
+
+/* Check to see if a key or button press is waiting. Other events are skipped. */
+
+int gfx_event_waiting()
+{
+	XEvent event;
+
+	gfx_flush();
+
+	while (1) {
+		if(XCheckMaskEvent(gfx_display,-1,&event)) {
+			if(event.type==KeyPress) {
+				XPutBackEvent(gfx_display,&event);
+				return 1;
+			} else if (event.type==ButtonPress) {
+				XPutBackEvent(gfx_display,&event);
+				return 1;
+			} else if (event.type==MotionNotify) {
+				saved_xpos = event.xmotion.x;
+				saved_ypos = event.xmotion.y;
+			}
+		} else {
+			return 0;
+		}
+	}
+}
+
+/* Wait for the user to press a key or mouse button. */
+
+char gfx_wait()
+{
+	XEvent event;
+
+	gfx_flush();
+
+	while(1) {
+		XNextEvent(gfx_display,&event);
+
+		if(event.type==KeyPress) {
+			saved_xpos = event.xkey.x;
+			saved_ypos = event.xkey.y;
+			return XLookupKeysym(&event.xkey,0);
+		} else if(event.type==ButtonPress) {
+			saved_xpos = event.xkey.x;
+			saved_ypos = event.xkey.y;
+			return event.xbutton.button;
+		} else if(event.type==MotionNotify) {
+			saved_xpos = event.xmotion.x;
+			saved_ypos = event.xmotion.y;
+		}
+	}
+}
+
+/* Take the next pending event without waiting. */
+
+int gfx_poll( char *key, int *x, int *y, unsigned long *time )
+{
+	XEvent event;
+
+	while(XCheckMaskEvent(gfx_display,-1,&event)) {
+		if(event.type==KeyPress) {
+			*key = XLookupKeysym(&event.xkey,0);
+			*x = saved_xpos = event.xkey.x;
+			*y = saved_ypos = event.xkey.y;
+			*time = event.xkey.time;
+			return GFX_KEY;
+		} else if(event.type==ButtonPress) {
+			*key = event.xbutton.button;
+			*x = saved_xpos = event.xbutton.x;
+			*y = saved_ypos = event.xbutton.y;
+			*time = event.xbutton.time;
+			return GFX_CLICK;
+		} else if(event.type==MotionNotify) {
+			*key = 0;
+			*x = saved_xpos = event.xmotion.x;
+			*y = saved_ypos = event.xmotion.y;
+			*time = event.xmotion.time;
+			return GFX_MOTION;
+		}
+	}
+	return GFX_NONE;
+}
+
+/* Return the X and Y coordinates of the last event. */
+
+int gfx_xpos()
+{
+	return saved_xpos;
+}
+
+int gfx_ypos()
+{
+	return saved_ypos;
+}
+
+/* Return the X and Y dimensions of the screen (monitor). */
+
+int gfx_xsize()
+{
+	return XDisplayWidth(gfx_display,0);
+}
+
+int gfx_ysize()
+{
+	return XDisplayHeight(gfx_display,0);
+}
+
+/* Display a string at (x,y), in the built-in font (gfx_font.c) instead of the */
+/* server's, so it matches the framebuffer backend pixel for pixel. The cached */
+/* layout is already in CoordModePrevious order: only its first point moves. */
+
+typedef char gfx_point_is_xpoint[sizeof(GfxPoint)==sizeof(XPoint) ? 1 : -1];
+
+void gfx_text( int x, int y, const char *text )
+{
+	GfxTextLayout *t = gfx_text_layout(text);
+
+	if(t->count==0) return;
+	t->points[0].x += x;
+	t->points[0].y += y;
+	XDrawPoints(gfx_display,gfx_window,gfx_gc,(XPoint *)t->points,t->count,CoordModePrevious);
+	t->points[0].x -= x;
+	t->points[0].y -= y;
+}
+
+/* Report and reset the line, point and color counters. */
+
+void gfx_counters( int *lines, int *offscreen, int *points, int *colors )
+{
+	*lines = count_lines;
+	*offscreen = count_offscreen;
+	*points = count_points;
+	*colors = count_colors;
+	count_lines = count_offscreen = count_points = count_colors = 0;
+}
+
+/* Flush all previous output to the window. */
+
+void gfx_flush()
+{
+	XFlush(gfx_display);
+}
+
+/* Flush and wait for the server to process everything (XSync). */
+
+void gfx_sync()
+{
+	XSync(gfx_display,False);
+}
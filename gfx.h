@@ -12,12 +12,19 @@ void gfx_open( int width, int height, const char *title );
 // Flush all previous output to the window. 
 void gfx_flush();
 
+// Flush and wait until everything sent so far has been drawn (a round trip to the display). 
+void gfx_sync();
+
 // Change the current drawing color. 
 void gfx_color( int red, int green, int blue );
 
-// Clear the graphics window to the background color. 
+// Clear the graphics window (or the clip rectangle) to the background color. 
 void gfx_clear();
 
+// Only draw (and clear) inside the w x h rectangle at (x,y). 
+// w or h <= 0 goes back to the whole window. 
+void gfx_clip( int x, int y, int w, int h );
+
 // Change the current background color. 
 void gfx_clear_color( int red, int green, int blue );
 
@@ -27,6 +34,17 @@ int gfx_event_waiting();
 // Wait for the user to press a key or mouse button. 
 char gfx_wait();
 
+// Event types returned by gfx_poll 
+#define GFX_NONE 0
+#define GFX_KEY 1
+#define GFX_CLICK 2
+#define GFX_MOTION 3
+
+// Take the next pending event without waiting. Returns its type (GFX_NONE if 
+// nothing is waiting) and fills in the key or button, the pointer position and 
+// the X server timestamp in milliseconds. 
+int gfx_poll( char *key, int *x, int *y, unsigned long *time );
+
 // Return the X and Y coordinates of the last event. 
 int gfx_xpos();
 int gfx_ypos();
@@ -41,11 +59,22 @@ void gfx_point( int x, int y );
 // Draw a line from (x1,y1) to (x2,y2) 
 void gfx_line( int x1, int y1, int x2, int y2 );
 
+// Draw n separate lines at once, xy holds x1,y1,x2,y2 for each line 
+void gfx_segments( const int *xy, int n );
+
+// Draw one connected line through n points, xy holds x,y for each point 
+void gfx_polyline( const int *xy, int n );
+
 // Draw a circle centered at (xc,yc) with radius r 
 void gfx_circle( int xc, int yc, int r );
 
 // Display a string at (x,y) 
 void gfx_text( int x, int y , const char *text );
 
+// Lines drawn, lines entirely off one side of the window (clip rectangle), line endpoints sent 
+// (2 per separate line, 1 per polyline point) and color changes since the last call, then start 
+// counting from zero again (for profiling a frame) 
+void gfx_counters( int *lines, int *offscreen, int *points, int *colors );
+
 #endif
 
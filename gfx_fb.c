@@ -0,0 +1,272 @@
+/*
+ * Framebuffer backend for the gfx library
+ * Author: Matus Vecera
+ *
+ * Implements the gfx.h drawing calls into an in-memory RGB framebuffer, so the
+ * same game code can render frames with no X display (see render.c).
+ * There are no input events here: gfx_event_waiting and gfx_poll always say no.
+ * Text uses the same built-in font as gfx.c, so frames match the window.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "gfx.h"
+#include "gfx_fb.h"
+#include "gfx_font.h"
+
+static unsigned char *fb_pixels = 0;
+static int fb_width = 0, fb_height = 0;
+static unsigned char fb_color[3] = {255, 255, 255};
+static unsigned char fb_background[3] = {0, 0, 0};
+static int count_lines = 0, count_offscreen = 0, count_points = 0, count_colors = 0;
+static int clip_x0 = 0, clip_y0 = 0, clip_x1 = 0, clip_y1 = 0; // gfx_clip rectangle, x1/y1 exclusive
+
+// Write one pixel in the current color, ignoring anything outside the clip rectangle
+static void fb_plot( int x, int y )
+{
+	unsigned char *p;
+	if(x<clip_x0 || y<clip_y0 || x>=clip_x1 || y>=clip_y1) return;
+	p = fb_pixels + ((size_t)y*fb_width + x)*3;
+	p[0] = fb_color[0];
+	p[1] = fb_color[1];
+	p[2] = fb_color[2];
+}
+
+// Outcode for Cohen-Sutherland clipping against the clip rectangle
+static int fb_outcode( double x, double y )
+{
+	int code = 0;
+	if(x<clip_x0) code |= 1; else if(x>clip_x1-1) code |= 2;
+	if(y<clip_y0) code |= 4; else if(y>clip_y1-1) code |= 8;
+	return code;
+}
+
+void gfx_open( int width, int height, const char *title )
+{
+	(void)title;
+	fb_pixels = malloc((size_t)width*height*3);
+	if(!fb_pixels) exit(1);
+	fb_width = width;
+	fb_height = height;
+	gfx_clip(0, 0, 0, 0);
+	gfx_clear();
+}
+
+// Nothing to flush, the frame is already in memory
+void gfx_flush()
+{
+}
+
+// Drawing is done when the call returns, nothing to wait for
+void gfx_sync()
+{
+}
+
+void gfx_color( int r, int g, int b )
+{
+	count_colors++;
+	fb_color[0] = (unsigned char)r;
+	fb_color[1] = (unsigned char)g;
+	fb_color[2] = (unsigned char)b;
+}
+
+// Clears the clip rectangle, one row at a time (the whole buffer when not clipped)
+void gfx_clear()
+{
+	int i, y, n = clip_x1-clip_x0;
+	unsigned char *p;
+
+	for(y=clip_y0;y<clip_y1;y++) {
+		p = fb_pixels + ((size_t)y*fb_width + clip_x0)*3;
+		if(fb_background[0]==fb_background[1] && fb_background[1]==fb_background[2]) {
+			memset(p, fb_background[0], (size_t)n*3);
+			continue;
+		}
+		for(i=0;i<n;i++) {
+			p[0] = fb_background[0];
+			p[1] = fb_background[1];
+			p[2] = fb_background[2];
+			p += 3;
+		}
+	}
+}
+
+// Clamped to the buffer, w or h <= 0 = the whole buffer
+void gfx_clip( int x, int y, int w, int h )
+{
+	if(w<=0 || h<=0) {
+		x = y = 0;
+		w = fb_width;
+		h = fb_height;
+	}
+	clip_x0 = x<0 ? 0 : x;
+	clip_y0 = y<0 ? 0 : y;
+	clip_x1 = x+w>fb_width ? fb_width : x+w;
+	clip_y1 = y+h>fb_height ? fb_height : y+h;
+}
+
+void gfx_clear_color( int r, int g, int b )
+{
+	fb_background[0] = (unsigned char)r;
+	fb_background[1] = (unsigned char)g;
+	fb_background[2] = (unsigned char)b;
+}
+
+int gfx_event_waiting()
+{
+	return 0;
+}
+
+char gfx_wait()
+{
+	return 0;
+}
+
+int gfx_poll( char *key, int *x, int *y, unsigned long *time )
+{
+	(void)key; (void)x; (void)y; (void)time;
+	return GFX_NONE;
+}
+
+int gfx_xpos()
+{
+	return fb_width/2;
+}
+
+int gfx_ypos()
+{
+	return fb_height/2;
+}
+
+int gfx_xsize()
+{
+	return fb_width;
+}
+
+int gfx_ysize()
+{
+	return fb_height;
+}
+
+void gfx_point( int x, int y )
+{
+	fb_plot(x, y);
+}
+
+// Clip to the framebuffer first (the game passes far off-screen endpoints),
+// then step along the major axis with Bresenham
+static void fb_line( int x1, int y1, int x2, int y2 )
+{
+	double ax = x1, ay = y1, bx = x2, by = y2, x, y;
+	int ca = fb_outcode(ax, ay), cb = fb_outcode(bx, by), c;
+	int dx, dy, sx, sy, err, e2;
+
+	// Entirely off one side: counted the same way as the X backend does
+	count_lines++;
+	if(ca & cb) {
+		count_offscreen++;
+		return;
+	}
+
+	while(ca | cb) {
+		if(ca & cb) return;
+		c = ca ? ca : cb;
+		if(c & 8)      { x = ax + (bx-ax)*(clip_y1-1-ay)/(by-ay); y = clip_y1-1; }
+		else if(c & 4) { x = ax + (bx-ax)*(clip_y0-ay)/(by-ay); y = clip_y0; }
+		else if(c & 2) { y = ay + (by-ay)*(clip_x1-1-ax)/(bx-ax); x = clip_x1-1; }
+		else           { y = ay + (by-ay)*(clip_x0-ax)/(bx-ax); x = clip_x0; }
+		if(c == ca) { ax = x; ay = y; ca = fb_outcode(ax, ay); }
+		else        { bx = x; by = y; cb = fb_outcode(bx, by); }
+	}
+
+	x1 = (int)(ax+0.5); y1 = (int)(ay+0.5);
+	x2 = (int)(bx+0.5); y2 = (int)(by+0.5);
+	dx = abs(x2-x1); sx = x1<x2 ? 1 : -1;
+	dy = -abs(y2-y1); sy = y1<y2 ? 1 : -1;
+	err = dx+dy;
+	while(1) {
+		fb_plot(x1, y1);
+		if(x1==x2 && y1==y2) break;
+		e2 = 2*err;
+		if(e2 >= dy) { err += dy; x1 += sx; }
+		if(e2 <= dx) { err += dx; y1 += sy; }
+	}
+}
+
+void gfx_line( int x1, int y1, int x2, int y2 )
+{
+	count_points += 2;
+	fb_line(x1, y1, x2, y2);
+}
+
+// Nothing to batch in memory, each segment is just a clipped line
+void gfx_segments( const int *xy, int n )
+{
+	for(; n>0; n--, xy+=4) gfx_line(xy[0], xy[1], xy[2], xy[3]);
+}
+
+// A strip is each pair of neighbouring points as a clipped line, the same pixels
+// gfx_segments would give for the same lines (shared points are just plotted twice)
+void gfx_polyline( const int *xy, int n )
+{
+	if(n<2) return;
+	count_points += n;
+	for(; n>1; n--, xy+=2) fb_line(xy[0], xy[1], xy[2], xy[3]);
+}
+
+// Midpoint circle, all eight octants at once
+void gfx_circle( int xc, int yc, int r )
+{
+	int x = r, y = 0, err = 1-r;
+
+	while(x >= y) {
+		fb_plot(xc+x, yc+y); fb_plot(xc-x, yc+y);
+		fb_plot(xc+x, yc-y); fb_plot(xc-x, yc-y);
+		fb_plot(xc+y, yc+x); fb_plot(xc-y, yc+x);
+		fb_plot(xc+y, yc-x); fb_plot(xc-y, yc-x);
+		y++;
+		if(err < 0) {
+			err += 2*y+1;
+		} else {
+			x--;
+			err += 2*(y-x)+1;
+		}
+	}
+}
+
+// Same built-in font and layout cache as the X backend (gfx_font.c)
+void gfx_text( int x, int y, const char *text )
+{
+	GfxTextLayout *t = gfx_text_layout(text);
+	int i;
+
+	for(i=0;i<t->count;i++) {
+		x += t->points[i].x;
+		y += t->points[i].y;
+		fb_plot(x, y);
+	}
+}
+
+void gfx_counters( int *lines, int *offscreen, int *points, int *colors )
+{
+	*lines = count_lines;
+	*offscreen = count_offscreen;
+	*points = count_points;
+	*colors = count_colors;
+	count_lines = count_offscreen = count_points = count_colors = 0;
+}
+
+unsigned char *gfx_fb_pixels( void )
+{
+	return fb_pixels;
+}
+
+int gfx_fb_width( void )
+{
+	return fb_width;
+}
+
+int gfx_fb_height( void )
+{
+	return fb_height;
+}
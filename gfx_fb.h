@@ -0,0 +1,16 @@
+// Framebuffer backend for the gfx library
+// gfx_fb.c implements everything in gfx.h by drawing into memory instead of
+// an X window, so the game can render without a display. These are the extras
+// it adds on top of gfx.h.
+
+#ifndef GFX_FB_H
+#define GFX_FB_H
+
+// Packed RGB pixels of the current frame, row major, 3 bytes per pixel
+unsigned char *gfx_fb_pixels( void );
+
+// Size of the framebuffer opened with gfx_open
+int gfx_fb_width( void );
+int gfx_fb_height( void );
+
+#endif
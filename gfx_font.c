@@ -0,0 +1,196 @@
+/*
+Built-in bitmap font and text layout cache for the gfx library.
+
+Every printable ASCII character is a 5x8 mask (rows 0-6 above the baseline,
+row 7 below it), one byte per row with bit 4 as the leftmost column.
+Laying out a string turns it into the list of its lit pixels once, after that
+drawing the same string again is a hash, a compare and a blit of that list:
+no glyph lookups and no per-character work.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gfx_font.h"
+
+/* Glyph masks for ' ' (32) to '~' (126). Anything else draws as '?'. */
+
+static const unsigned char gfx_font[95][8] = {
+	{0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, /* space */
+	{0x04,0x04,0x04,0x04,0x04,0x00,0x04,0x00}, /* ! */
+	{0x0a,0x0a,0x0a,0x00,0x00,0x00,0x00,0x00}, /* " */
+	{0x0a,0x0a,0x1f,0x0a,0x1f,0x0a,0x0a,0x00}, /* # */
+	{0x04,0x0f,0x14,0x0e,0x05,0x1e,0x04,0x00}, /* $ */
+	{0x18,0x19,0x02,0x04,0x08,0x13,0x03,0x00}, /* % */
+	{0x0c,0x12,0x14,0x08,0x15,0x12,0x0d,0x00}, /* & */
+	{0x04,0x04,0x08,0x00,0x00,0x00,0x00,0x00}, /* quote */
+	{0x02,0x04,0x08,0x08,0x08,0x04,0x02,0x00}, /* ( */
+	{0x08,0x04,0x02,0x02,0x02,0x04,0x08,0x00}, /* ) */
+	{0x00,0x04,0x15,0x0e,0x15,0x04,0x00,0x00}, /* * */
+	{0x00,0x04,0x04,0x1f,0x04,0x04,0x00,0x00}, /* + */
+	{0x00,0x00,0x00,0x00,0x00,0x04,0x04,0x08}, /* , */
+	{0x00,0x00,0x00,0x1f,0x00,0x00,0x00,0x00}, /* - */
+	{0x00,0x00,0x00,0x00,0x00,0x0c,0x0c,0x00}, /* . */
+	{0x00,0x01,0x02,0x04,0x08,0x10,0x00,0x00}, /* / */
+	{0x0e,0x11,0x13,0x15,0x19,0x11,0x0e,0x00}, /* 0 */
+	{0x04,0x0c,0x04,0x04,0x04,0x04,0x0e,0x00}, /* 1 */
+	{0x0e,0x11,0x01,0x02,0x04,0x08,0x1f,0x00}, /* 2 */
+	{0x1f,0x02,0x04,0x02,0x01,0x11,0x0e,0x00}, /* 3 */
+	{0x02,0x06,0x0a,0x12,0x1f,0x02,0x02,0x00}, /* 4 */
+	{0x1f,0x10,0x1e,0x01,0x01,0x11,0x0e,0x00}, /* 5 */
+	{0x06,0x08,0x10,0x1e,0x11,0x11,0x0e,0x00}, /* 6 */
+	{0x1f,0x01,0x02,0x04,0x08,0x08,0x08,0x00}, /* 7 */
+	{0x0e,0x11,0x11,0x0e,0x11,0x11,0x0e,0x00}, /* 8 */
+	{0x0e,0x11,0x11,0x0f,0x01,0x02,0x0c,0x00}, /* 9 */
+	{0x00,0x0c,0x0c,0x00,0x0c,0x0c,0x00,0x00}, /* : */
+	{0x00,0x0c,0x0c,0x00,0x0c,0x0c,0x04,0x08}, /* ; */
+	{0x02,0x04,0x08,0x10,0x08,0x04,0x02,0x00}, /* < */
+	{0x00,0x00,0x1f,0x00,0x1f,0x00,0x00,0x00}, /* = */
+	{0x08,0x04,0x02,0x01,0x02,0x04,0x08,0x00}, /* > */
+	{0x0e,0x11,0x01,0x02,0x04,0x00,0x04,0x00}, /* ? */
+	{0x0e,0x11,0x01,0x0d,0x15,0x15,0x0e,0x00}, /* @ */
+	{0x0e,0x11,0x11,0x1f,0x11,0x11,0x11,0x00}, /* A */
+	{0x1e,0x11,0x11,0x1e,0x11,0x11,0x1e,0x00}, /* B */
+	{0x0e,0x11,0x10,0x10,0x10,0x11,0x0e,0x00}, /* C */
+	{0x1c,0x12,0x11,0x11,0x11,0x12,0x1c,0x00}, /* D */
+	{0x1f,0x10,0x10,0x1e,0x10,0x10,0x1f,0x00}, /* E */
+	{0x1f,0x10,0x10,0x1e,0x10,0x10,0x10,0x00}, /* F */
+	{0x0e,0x11,0x10,0x17,0x11,0x11,0x0f,0x00}, /* G */
+	{0x11,0x11,0x11,0x1f,0x11,0x11,0x11,0x00}, /* H */
+	{0x0e,0x04,0x04,0x04,0x04,0x04,0x0e,0x00}, /* I */
+	{0x07,0x02,0x02,0x02,0x02,0x12,0x0c,0x00}, /* J */
+	{0x11,0x12,0x14,0x18,0x14,0x12,0x11,0x00}, /* K */
+	{0x10,0x10,0x10,0x10,0x10,0x10,0x1f,0x00}, /* L */
+	{0x11,0x1b,0x15,0x15,0x11,0x11,0x11,0x00}, /* M */
+	{0x11,0x11,0x19,0x15,0x13,0x11,0x11,0x00}, /* N */
+	{0x0e,0x11,0x11,0x11,0x11,0x11,0x0e,0x00}, /* O */
+	{0x1e,0x11,0x11,0x1e,0x10,0x10,0x10,0x00}, /* P */
+	{0x0e,0x11,0x11,0x11,0x15,0x12,0x0d,0x00}, /* Q */
+	{0x1e,0x11,0x11,0x1e,0x14,0x12,0x11,0x00}, /* R */
+	{0x0f,0x10,0x10,0x0e,0x01,0x01,0x1e,0x00}, /* S */
+	{0x1f,0x04,0x04,0x04,0x04,0x04,0x04,0x00}, /* T */
+	{0x11,0x11,0x11,0x11,0x11,0x11,0x0e,0x00}, /* U */
+	{0x11,0x11,0x11,0x11,0x11,0x0a,0x04,0x00}, /* V */
+	{0x11,0x11,0x11,0x15,0x15,0x15,0x0a,0x00}, /* W */
+	{0x11,0x11,0x0a,0x04,0x0a,0x11,0x11,0x00}, /* X */
+	{0x11,0x11,0x11,0x0a,0x04,0x04,0x04,0x00}, /* Y */
+	{0x1f,0x01,0x02,0x04,0x08,0x10,0x1f,0x00}, /* Z */
+	{0x0e,0x08,0x08,0x08,0x08,0x08,0x0e,0x00}, /* [ */
+	{0x00,0x10,0x08,0x04,0x02,0x01,0x00,0x00}, /* backslash */
+	{0x0e,0x02,0x02,0x02,0x02,0x02,0x0e,0x00}, /* ] */
+	{0x04,0x0a,0x11,0x00,0x00,0x00,0x00,0x00}, /* ^ */
+	{0x00,0x00,0x00,0x00,0x00,0x00,0x1f,0x00}, /* _ */
+	{0x08,0x04,0x02,0x00,0x00,0x00,0x00,0x00}, /* ` */
+	{0x00,0x00,0x0e,0x01,0x0f,0x11,0x0f,0x00}, /* a */
+	{0x10,0x10,0x16,0x19,0x11,0x11,0x1e,0x00}, /* b */
+	{0x00,0x00,0x0e,0x10,0x10,0x11,0x0e,0x00}, /* c */
+	{0x01,0x01,0x0d,0x13,0x11,0x11,0x0f,0x00}, /* d */
+	{0x00,0x00,0x0e,0x11,0x1f,0x10,0x0e,0x00}, /* e */
+	{0x06,0x09,0x08,0x1c,0x08,0x08,0x08,0x00}, /* f */
+	{0x00,0x00,0x0f,0x11,0x11,0x0f,0x01,0x0e}, /* g */
+	{0x10,0x10,0x16,0x19,0x11,0x11,0x11,0x00}, /* h */
+	{0x04,0x00,0x0c,0x04,0x04,0x04,0x0e,0x00}, /* i */
+	{0x02,0x00,0x06,0x02,0x02,0x02,0x12,0x0c}, /* j */
+	{0x10,0x10,0x12,0x14,0x18,0x14,0x12,0x00}, /* k */
+	{0x0c,0x04,0x04,0x04,0x04,0x04,0x0e,0x00}, /* l */
+	{0x00,0x00,0x1a,0x15,0x15,0x11,0x11,0x00}, /* m */
+	{0x00,0x00,0x16,0x19,0x11,0x11,0x11,0x00}, /* n */
+	{0x00,0x00,0x0e,0x11,0x11,0x11,0x0e,0x00}, /* o */
+	{0x00,0x00,0x1e,0x11,0x11,0x1e,0x10,0x10}, /* p */
+	{0x00,0x00,0x0f,0x11,0x11,0x0f,0x01,0x01}, /* q */
+	{0x00,0x00,0x16,0x19,0x10,0x10,0x10,0x00}, /* r */
+	{0x00,0x00,0x0e,0x10,0x0e,0x01,0x1e,0x00}, /* s */
+	{0x08,0x08,0x1c,0x08,0x08,0x09,0x06,0x00}, /* t */
+	{0x00,0x00,0x11,0x11,0x11,0x13,0x0d,0x00}, /* u */
+	{0x00,0x00,0x11,0x11,0x11,0x0a,0x04,0x00}, /* v */
+	{0x00,0x00,0x11,0x11,0x15,0x15,0x0a,0x00}, /* w */
+	{0x00,0x00,0x11,0x0a,0x04,0x0a,0x11,0x00}, /* x */
+	{0x00,0x00,0x11,0x11,0x11,0x0f,0x01,0x0e}, /* y */
+	{0x00,0x00,0x1f,0x02,0x04,0x08,0x1f,0x00}, /* z */
+	{0x02,0x04,0x04,0x08,0x04,0x04,0x02,0x00}, /* { */
+	{0x04,0x04,0x04,0x04,0x04,0x04,0x04,0x00}, /* | */
+	{0x08,0x04,0x04,0x02,0x04,0x04,0x08,0x00}, /* } */
+	{0x00,0x00,0x08,0x15,0x02,0x00,0x00,0x00}, /* ~ */
+};
+
+static GfxTextLayout text_cache[GFX_TEXT_CACHE];
+static unsigned int text_clock = 0;
+static int text_hits = 0, text_misses = 0;
+
+/* FNV-1a hash of the part of the string that gets laid out. */
+
+static unsigned int text_hash( const char *text )
+{
+	unsigned int h = 2166136261u;
+	int i;
+	for(i=0;i<GFX_TEXT_MAX-1 && text[i];i++) {
+		h ^= (unsigned char)text[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/* Fill a cache slot with the lit pixels of text, glyph after glyph. */
+
+static void text_build( GfxTextLayout *t, const char *text )
+{
+	int i, row, col, c, len, px = 0, py = 0;
+	unsigned char bits;
+	GfxPoint *p;
+
+	strncpy(t->text, text, GFX_TEXT_MAX-1);
+	t->text[GFX_TEXT_MAX-1] = 0;
+	t->count = 0;
+	len = strlen(t->text);
+	if(len*40 > t->capacity) {
+		p = realloc(t->points, (size_t)len*40*sizeof(GfxPoint));
+		if(!p) return; // nothing to draw, the old points stay allocated
+		t->points = p;
+		t->capacity = len*40;
+	}
+
+	for(i=0;i<len;i++) {
+		c = (unsigned char)t->text[i];
+		if(c<32 || c>126) c = '?';
+		for(row=0;row<8;row++) {
+			bits = gfx_font[c-32][row];
+			for(col=0;col<5;col++) {
+				if(!(bits & (0x10>>col))) continue;
+				p = &t->points[t->count++];
+				p->x = (short)(i*GFX_FONT_ADVANCE + col - px);
+				p->y = (short)(row - GFX_FONT_ASCENT - py);
+				px = i*GFX_FONT_ADVANCE + col;
+				py = row - GFX_FONT_ASCENT;
+			}
+		}
+	}
+}
+
+GfxTextLayout *gfx_text_layout( const char *text )
+{
+	unsigned int h = text_hash(text);
+	GfxTextLayout *t, *oldest = 0;
+	int i;
+
+	text_clock++;
+	for(i=0;i<GFX_TEXT_WAYS;i++) {
+		t = &text_cache[(h+i) % GFX_TEXT_CACHE];
+		if(t->used && strncmp(t->text, text, GFX_TEXT_MAX-1)==0) {
+			text_hits++;
+			t->used = text_clock;
+			return t;
+		}
+		if(!oldest || t->used < oldest->used) oldest = t;
+	}
+	text_misses++;
+	text_build(oldest, text);
+	oldest->used = text_clock;
+	return oldest;
+}
+
+void gfx_text_stats( int *hits, int *misses )
+{
+	*hits = text_hits;
+	*misses = text_misses;
+	text_hits = text_misses = 0;
+}
@@ -0,0 +1,36 @@
+// Built-in bitmap font for the gfx library 
+// Both backends (gfx.c for X, gfx_fb.c for the framebuffer) draw text through 
+// this, so a string looks exactly the same in the window and in rendered frames. 
+
+#ifndef GFX_FONT_H
+#define GFX_FONT_H
+
+#define GFX_FONT_ADVANCE 6   // pixels from one character to the next (5 wide + 1 gap) 
+#define GFX_FONT_ASCENT 7    // glyph rows above the baseline, one more below it for descenders 
+#define GFX_TEXT_MAX 96      // longest string laid out (including the 0), longer text is cut 
+#define GFX_TEXT_CACHE 32    // laid out strings kept 
+#define GFX_TEXT_WAYS 4      // slots a string may sit in (from a hash of it), the least recently used one is replaced 
+
+// One lit pixel. Laid out like XPoint, so the X backend can hand a list straight to XDrawPoints. 
+typedef struct {
+	short x, y;
+} GfxPoint;
+
+// A laid out string: every lit pixel of its glyphs. points[0] is relative to the 
+// text origin (left end of the baseline), each later point to the one before it. 
+typedef struct {
+	char text[GFX_TEXT_MAX];
+	unsigned int used; // when it was last drawn (a counter), 0 = empty slot 
+	int count;         // points in the layout 
+	int capacity;      // points allocated 
+	GfxPoint *points;
+} GfxTextLayout;
+
+// Layout of a string, straight from the cache if the same string was drawn before. 
+// A backend may move points[0] while drawing, as long as it puts it back. 
+GfxTextLayout *gfx_text_layout( const char *text );
+
+// Strings found in the cache and strings laid out since the last call, then start counting from zero again 
+void gfx_text_stats( int *hits, int *misses );
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * 3D Flight Shooter - input queue
+ * Author: Matus Vecera
+ *
+ * See input.h. X timestamps are milliseconds on the X server's clock, so they are
+ * moved onto our clock with an offset: the smallest (now - event time) ever seen
+ * is the offset with the least delivery delay in it, which is the best estimate.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gfx.h"
+#include "project.h"
+#include "input.h"
+
+// Start with an empty queue and the mouse at (mouse_x, mouse_y)
+void input_init(InputQueue *in, int mouse_x, int mouse_y) {
+    memset(in, 0, sizeof(*in));
+    in->mouse_x = mouse_x;
+    in->mouse_y = mouse_y;
+}
+
+// Convert an X server timestamp to our clock, refining the offset as we go
+double input_event_time(InputQueue *in, unsigned long server_ms, double now) {
+    double offset = now - server_ms / 1000.0;
+    
+    if (!in->have_offset || offset < in->clock_offset) {
+        in->clock_offset = offset;
+        in->have_offset = 1;
+    }
+    return server_ms / 1000.0 + in->clock_offset;
+}
+
+// Drain every pending event, call once at the start of a frame
+// Returns the number of clicks/keys queued for this frame
+int input_poll(InputQueue *in) {
+    char key;
+    int type, x, y;
+    unsigned long server_ms;
+    double now = now_seconds();
+    InputEvent *ev;
+    
+    in->count = 0;
+    in->dropped = 0;
+    in->motion_count = 0;
+    
+    while ((type = gfx_poll(&key, &x, &y, &server_ms)) != GFX_NONE) {
+        // Every event carries the pointer position, keep the newest
+        in->mouse_x = x;
+        in->mouse_y = y;
+        
+        if (type == GFX_MOTION) {
+            in->motion_count++;
+            in->motion_time = input_event_time(in, server_ms, now);
+            continue;
+        }
+        if (in->count == INPUT_QUEUE_SIZE) {
+            in->dropped++;
+            continue;
+        }
+        ev = &in->events[in->count++];
+        ev->key = key;
+        ev->x = x;
+        ev->y = y;
+        ev->time = input_event_time(in, server_ms, now);
+    }
+    return in->count;
+}
+
+// Add one latency sample to the ring
+void input_add_latency(InputQueue *in, double ms) {
+    in->latency_ms[in->latency_next] = ms;
+    in->latency_next = (in->latency_next + 1) % LATENCY_SAMPLES;
+    if (in->latency_count < LATENCY_SAMPLES) in->latency_count++;
+}
+
+// The frame holding this frame's input was just flushed: record its latencies
+// Each click/key counts once, and so does the newest motion (the one the
+// steering actually used, older coalesced motion never reaches the screen)
+void input_shown(InputQueue *in, double flush_time) {
+    int i;
+    
+    for (i = 0; i < in->count; i++) {
+        input_add_latency(in, (flush_time - in->events[i].time) * 1000.0);
+    }
+    if (in->motion_count > 0) {
+        input_add_latency(in, (flush_time - in->motion_time) * 1000.0);
+    }
+}
+
+// qsort comparison for doubles
+int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Median and 99th percentile of the recorded latencies, returns the sample count
+int input_latency(InputQueue *in, double *p50, double *p99) {
+    double sorted[LATENCY_SAMPLES];
+    int n = in->latency_count;
+    
+    *p50 = *p99 = 0.0;
+    if (n == 0) return 0;
+    memcpy(sorted, in->latency_ms, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), compare_doubles);
+    *p50 = sorted[n / 2];
+    *p99 = sorted[(n * 99) / 100];
+    return n;
+}
+
+// Print the latency stats to the terminal
+void input_report(InputQueue *in) {
+    double p50, p99;
+    int n = input_latency(in, &p50, &p99);
+    
+    if (n > 0) {
+        printf("Input latency: p50 %.1f ms, p99 %.1f ms (last %d events)\n", p50, p99, n);
+    }
+}
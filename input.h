@@ -0,0 +1,44 @@
+/*
+ * 3D Flight Shooter - input queue
+ * Author: Matus Vecera
+ *
+ * All pending X events are drained at the start of each frame. Clicks and keys
+ * are queued in order with their timestamps, pointer motion is coalesced into
+ * the latest mouse position. After the frame is flushed, the time from each
+ * event to that flush (input-to-photon latency) is recorded.
+ */
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#define INPUT_QUEUE_SIZE 64 // clicks/keys kept per frame, extras are dropped
+#define LATENCY_SAMPLES 1024 // most recent latencies used for p50/p99
+
+// One click or key press
+typedef struct {
+    char key;       // mouse button number (1 = left click) or key
+    int x, y;       // pointer position when it happened
+    double time;    // when it happened, seconds on the now_seconds() clock
+} InputEvent;
+
+// Input for one frame plus the latency history
+typedef struct {
+    InputEvent events[INPUT_QUEUE_SIZE];  // clicks and keys this frame, oldest first
+    int count;                            // events in the queue
+    int dropped;                          // events that did not fit this frame
+    int mouse_x, mouse_y;                 // latest pointer position (motion coalesced)
+    int motion_count;                     // motion events folded into mouse_x/y this frame
+    double motion_time;                   // timestamp of the newest motion this frame
+    double clock_offset;                  // now_seconds() minus X server time, smallest seen
+    int have_offset;
+    double latency_ms[LATENCY_SAMPLES];   // ring of event-to-flush latencies
+    int latency_count, latency_next;
+} InputQueue;
+
+void input_init(InputQueue *in, int mouse_x, int mouse_y);
+int input_poll(InputQueue *in);
+void input_shown(InputQueue *in, double flush_time);
+int input_latency(InputQueue *in, double *p50, double *p99);
+void input_report(InputQueue *in);
+
+#endif
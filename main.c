@@ -0,0 +1,191 @@
+/*
+ * 3D Flight Shooter - interactive X11 game loop
+ * Author: Matus Vecera
+ *
+ * Usage: ./project [-t target_ms] [-c counters.csv] [record.txt]
+ *   -t  frame time the quality governor tries to hold (default 12 ms, 0 = fixed detail)
+ *   -c  write every frame's time and work counters (lines, vertices, ...) to a CSV file
+ *   B rewinds one second, and on the lose screen it retries from 5 seconds before
+ *   With a file name every frame's mouse position and key/click events are
+ *   recorded, so the flight can be turned into a video later with ./render -i
+ */
+
+#define _XOPEN_SOURCE 500 // This is for the usleep function
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // for memset
+#include <unistd.h> // for usleep
+#include <time.h> // for time()
+#include "gfx.h"
+#include "project.h"
+#include "input.h"
+#include "atlas.h"
+
+#define STATE_PLAYING 0     // flying
+#define STATE_WIN_LOADING 1 // won, the portraits are still coming in
+#define STATE_WIN 2         // win screen finished, waiting for R or Q
+#define STATE_LOSE 3        // lose screen, waiting for R, B or Q
+#define PORTRAITS_PER_FRAME 4 // portraits put on the win screen per frame, so a frame stays short
+
+/* ==================== MAIN FUNCTION ==================== */
+// One loop for everything: every frame polls the input and then does whatever the
+// current state needs, the end screens never block waiting for a key
+
+int main(int argc, char *argv[]) {
+    GameState game; // main game state
+    InputQueue input; // this frame's clicks/keys and the latest mouse position
+    AtlasLoader portraits; // win screen pictures, packed at build time, loaded when you win
+    SnapshotRing snapshots; // the last few seconds, for B (rewind) and retry
+    ViewWorkers workers; // cull the extra views (mirror, split screen) next to the main one
+    char c;
+    int i, result;
+    int state = STATE_PLAYING, running = 1, flying;
+    int shown = 0, ready, total, done; // portraits on the win screen, loaded, in the atlas
+    unsigned int seed = (unsigned int)time(NULL);
+    FILE *record = NULL; // optional input recording for the offline renderer
+    FILE *csv = NULL; // optional per-frame counters
+    int frame = 0;
+    double target_ms = 12.0; // frame time the quality governor aims for
+    double frame_start, frame_ms;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "t:c:")) != -1) {
+        if (opt == 't') target_ms = atof(optarg);
+        else if (opt == 'c') {
+            csv = fopen(optarg, "w");
+            if (!csv) { perror(optarg); return 1; }
+            counters_csv_header(csv);
+        }
+        else { fprintf(stderr, "Usage: %s [-t target_ms] [-c counters.csv] [record.txt]\n", argv[0]); return 1; }
+    }
+    if (optind < argc) {
+        record = fopen(argv[optind], "w");
+        if (!record) { perror(argv[optind]); return 1; }
+        fprintf(record, "seed %u\n", seed);
+    }
+    
+    default_tuning(&game); // normal difficulty
+    seed_game(&game, seed); // Seed random number generator
+    init_game(&game); // Initialize game state
+    init_settings(&game, target_ms); // display settings, survive restarts
+    snapshot_init(&snapshots);
+    memset(&portraits, 0, sizeof(portraits)); // not started yet
+    
+    gfx_open(SCREEN_WIDTH, SCREEN_HEIGHT, "3D Flight Shooter - Fly toward mouse, Left CLick to shoot!"); //  Open graphics window
+    input_init(&input, SCREEN_CX, SCREEN_CY); // no steering until the mouse moves
+    view_workers_start(&workers);
+    
+    /* Main game loop */
+    while (running) {
+        frame_start = now_seconds();
+        flying = 0;
+        
+        /* Handle input: everything that arrived since last frame, before it is used */
+        input_poll(&input);
+        
+        if (state == STATE_PLAYING) {
+            if (record) fprintf(record, "%d %d", input.mouse_x, input.mouse_y);
+            for (i = 0; i < input.count && running; i++) {
+                c = input.events[i].key;
+                if (record) fprintf(record, " %d", c);
+                
+                if (c == 'b' || c == 'B') rewind_game(&game, &snapshots, REWIND_STEPS);
+                if (handle_key(&game, c)) running = 0;
+            }
+            if (record) fprintf(record, "\n");
+            if (!running) break;
+            
+            // Steer toward the latest mouse position, move everything, then print what happened
+            result = simulate_frame(&game, input.mouse_x, input.mouse_y);
+            report_events(&game);
+            
+            // Check if game over - show lose screen
+            if (result == SIM_LOST) {
+                game.final_time = (int)(time(NULL) - game.start_time);
+                printf("*** GAME OVER! ***\n"); // the score and input report come when you quit
+                
+                draw_lose_screen(&game);
+                if (record) { fclose(record); record = NULL; } // a recording ends with the flight
+                state = STATE_LOSE;
+            }
+            
+            // Check if player won - show win screen, the pictures follow as they load
+            else if (result == SIM_WON) { // won
+                game.show_Win_Screen = 1;
+                game.final_time = (int)(time(NULL) - game.start_time);  // Freeze time
+                printf("\n*** CONGRATULATIONS! You won in %d:%02d! ***\n", game.final_time / 60, game.final_time % 60);
+                printf("*** Press Q to quit, R to restart ***\n\n");
+                
+                draw_win_background(&game);
+                atlas_load_start(&portraits, "portraits.atlas"); // already loaded if we won before
+                shown = 0;
+                if (record) { fclose(record); record = NULL; }
+                state = STATE_WIN_LOADING;
+            }
+            
+            else {
+                snapshot_frame(&snapshots, &game); // every few frames, for rewinding
+                
+                // Draw everything
+                draw_frame(&game, &workers);
+                flying = 1;
+            }
+        } else {
+            // End screens: quit, restart, or (lose screen) retry from 5 seconds ago
+            for (i = 0; i < input.count && state != STATE_PLAYING; i++) {
+                c = input.events[i].key;
+                if (c == 'q' || c == 'Q') { //quit
+                    running = 0;
+                    break;
+                }
+                if (c == 'r' || c == 'R') { // restart
+                    init_game(&game); // Restart game
+                    snapshot_reset(&snapshots);
+                    gfx_clear_color(0, 0, 0);  /* Reset background to black */
+                    state = STATE_PLAYING;
+                }
+                if ((c == 'b' || c == 'B') && state == STATE_LOSE) { // retry (or the start, if it was shorter)
+                    rewind_game(&game, &snapshots, RETRY_STEPS);
+                    gfx_clear_color(0, 0, 0);
+                    state = STATE_PLAYING;
+                }
+            }
+            if (!running) break;
+            
+            // Put up the portraits that have arrived since last frame, a few at a time
+            if (state == STATE_WIN_LOADING) {
+                done = atlas_load_status(&portraits, &ready, &total);
+                for (i = 0; i < PORTRAITS_PER_FRAME && shown < ready; i++) {
+                    draw_win_portrait(&portraits.atlas, shown++);
+                }
+                draw_win_progress(shown, total, done && shown == ready);
+                if (done && shown == ready) {
+                    if (total == 0) printf("portraits.atlas not found (run make), the win screen has no pictures\n");
+                    state = STATE_WIN;
+                }
+            }
+        }
+        
+        gfx_flush();
+        // XFlush does not wait, so a played frame is timed up to the server having drawn it:
+        // a slow display (remote X, a busy server) then slows the frame and the governor sees it
+        if (flying) gfx_sync();
+        input_shown(&input, now_seconds());
+        if (flying) {
+            frame_ms = (now_seconds() - frame_start) * 1000.0;
+            governor_frame(&game, frame_ms);
+            if (csv) counters_csv_row(csv, frame++, frame_ms, &game.counters);
+        }
+        
+        usleep(12000);  /* ~80 FPS for smoother animation */
+    }
+    
+    printf("Final Score: %d\n", game.score);
+    input_report(&input);
+    report_snapshots(stdout, &snapshots);
+    atlas_load_stop(&portraits);
+    view_workers_stop(&workers);
+    if (record) fclose(record);
+    if (csv) fclose(csv);
+    return 0;
+}
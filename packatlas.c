@@ -0,0 +1,271 @@
+/*
+ * 3D Flight Shooter - portrait atlas packer (build tool)
+ * Author: Matus Vecera
+ *
+ * Usage: ./packatlas out.atlas -s size file.ppm ... [-s size file.ppm ...]
+ *        ./packatlas -b -s size file.ppm ...     (scaler benchmark, writes nothing)
+ *
+ * Reads every portrait, resamples it to size x size (the size the win screen
+ * draws it at, see scale.c), packs them all into one image on shelves and writes
+ * the atlas described in atlas.h. Missing files are skipped with a warning, the
+ * win screen just leaves that spot empty like it always did.
+ */
+
+#define _XOPEN_SOURCE 500 // for clock_gettime in the benchmark
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "atlas.h"
+#include "scale.h"
+
+#define MAX_PORTRAITS 64
+#define ATLAS_WIDTH 512 // shelves are this wide (or as wide as the widest portrait)
+
+// One portrait after resampling
+typedef struct {
+    char name[ATLAS_NAME_LEN];
+    int w, h;
+    unsigned char *rgb;
+    int x, y;  // place in the atlas
+} Portrait;
+
+// Skip whitespace and # comments in a PPM header
+void skip_ppm_space(FILE *f) {
+    int c = fgetc(f);
+    while (c == '#' || c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        if (c == '#') while (c != '\n' && c != EOF) c = fgetc(f);
+        c = fgetc(f);
+    }
+    ungetc(c, f);
+}
+
+// Read a binary (P6) PPM, returns malloc'd RGB pixels or NULL
+unsigned char *read_ppm(const char *filename, int *width, int *height) {
+    FILE *f = fopen(filename, "rb");
+    char magic[3];
+    int maxval;
+    unsigned char *rgb;
+    
+    if (!f) return NULL;
+    if (fscanf(f, "%2s", magic) != 1 || strcmp(magic, "P6") != 0) { fclose(f); return NULL; }
+    skip_ppm_space(f);
+    if (fscanf(f, "%d", width) != 1) { fclose(f); return NULL; }
+    skip_ppm_space(f);
+    if (fscanf(f, "%d", height) != 1) { fclose(f); return NULL; }
+    skip_ppm_space(f);
+    if (fscanf(f, "%d", &maxval) != 1 || *width <= 0 || *height <= 0) { fclose(f); return NULL; }
+    fgetc(f); // the one whitespace byte before the pixels
+    
+    rgb = calloc((size_t)*width * *height, 3);
+    if (rgb && fread(rgb, 3, (size_t)*width * *height, f) != (size_t)*width * *height) {
+        fprintf(stderr, "packatlas: %s is short, padding with black\n", filename);
+    }
+    fclose(f);
+    return rgb;
+}
+
+// Resample to dw x dh: area average when shrinking (all the portraits), nearest when enlarging
+unsigned char *resample(const unsigned char *src, int sw, int sh, int dw, int dh) {
+    unsigned char *dst = malloc((size_t)dw * dh * 3);
+    
+    if (dst && !scale_image(src, sw, sh, dst, dw, dh)) {
+        free(dst);
+        return NULL;
+    }
+    return dst;
+}
+
+// Portrait name = file name without directories and without .ppm
+void portrait_name(const char *filename, char *name) {
+    const char *base = strrchr(filename, '/');
+    size_t len;
+    
+    base = base ? base + 1 : filename;
+    len = strlen(base);
+    if (len > 4 && strcmp(base + len - 4, ".ppm") == 0) len -= 4;
+    if (len > ATLAS_NAME_LEN - 1) {
+        fprintf(stderr, "packatlas: name of %s is too long, cut to %d characters\n", filename, ATLAS_NAME_LEN - 1);
+        len = ATLAS_NAME_LEN - 1;
+    }
+    memset(name, 0, ATLAS_NAME_LEN);
+    memcpy(name, base, len);
+}
+
+// qsort order for shelf packing: tallest first
+int compare_height(const void *a, const void *b) {
+    return ((const Portrait *)b)->h - ((const Portrait *)a)->h;
+}
+
+// Place portraits left to right on shelves, returns the atlas height
+int pack_shelves(Portrait *p, int n, int width) {
+    int i, x = 0, y = 0, shelf = 0;
+    
+    qsort(p, n, sizeof(Portrait), compare_height);
+    for (i = 0; i < n; i++) {
+        if (x + p[i].w > width) { // start a new shelf under the tallest of this one
+            y += shelf;
+            x = 0;
+            shelf = 0;
+        }
+        p[i].x = x;
+        p[i].y = y;
+        x += p[i].w;
+        if (p[i].h > shelf) shelf = p[i].h;
+    }
+    return y + shelf;
+}
+
+/* ==================== SCALER BENCHMARK ==================== */
+// ./packatlas -b -s size files...  times every scaler on every picture, nothing is written
+
+typedef int (*Scaler)(const unsigned char *src, int sw, int sh, unsigned char *dst, int dw, int dh);
+
+// The sampling the win screen used to do, one integer divide per pixel (the reference)
+int scale_divide(const unsigned char *src, int sw, int sh, unsigned char *dst, int dw, int dh) {
+    int dx, dy, sx, sy;
+    
+    for (dy = 0; dy < dh; dy++) {
+        sy = (int)((long)dy * sh / dh);
+        for (dx = 0; dx < dw; dx++) {
+            sx = (int)((long)dx * sw / dw);
+            memcpy(dst + ((size_t)dy * dw + dx) * 3, src + ((size_t)sy * sw + sx) * 3, 3);
+        }
+    }
+    return 1;
+}
+
+double bench_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Milliseconds per call, repeated until it has run for at least 0.2 s
+double time_scaler(Scaler scale, const unsigned char *src, int sw, int sh, unsigned char *dst, int size) {
+    double t0 = bench_seconds(), t;
+    int runs = 0;
+    
+    do {
+        scale(src, sw, sh, dst, size, size);
+        runs++;
+        t = bench_seconds() - t0;
+    } while (t < 0.2);
+    return t * 1000.0 / runs;
+}
+
+int bench(int argc, char *argv[]) {
+    unsigned char *src, *ref, *dst;
+    double ms[3], total[3] = {0, 0, 0}, pixels = 0;
+    Scaler scalers[3] = {scale_divide, scale_nearest, scale_box};
+    int i, k, size = 0, sw, sh, differ;
+    
+    printf("%-20s %10s %5s %11s %11s %11s %12s %8s\n", "picture", "source", "size",
+           "divide ms", "16.16 ms", "box ms", "box Mpix/s", "differ");
+    for (i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            size = atoi(argv[++i]);
+            continue;
+        }
+        if (size <= 0) { fprintf(stderr, "packatlas: give -s size before %s\n", argv[i]); return 1; }
+        src = read_ppm(argv[i], &sw, &sh);
+        if (!src) {
+            fprintf(stderr, "packatlas: skipping %s (missing or not a P6 PPM)\n", argv[i]);
+            continue;
+        }
+        ref = malloc((size_t)size * size * 3);
+        dst = malloc((size_t)size * size * 3);
+        if (!ref || !dst) return 1;
+        
+        for (k = 0; k < 3; k++) {
+            ms[k] = time_scaler(scalers[k], src, sw, sh, k == 0 ? ref : dst, size);
+            total[k] += ms[k];
+        }
+        // 16.16 stepping should pick the same pixels as the divide version
+        scale_nearest(src, sw, sh, dst, size, size);
+        differ = 0;
+        for (k = 0; k < size * size * 3; k += 3) differ += memcmp(ref + k, dst + k, 3) != 0;
+        pixels += (double)sw * sh;
+        
+        printf("%-20s %4dx%-5d %5d %11.4f %11.4f %11.4f %12.1f %8d\n", argv[i], sw, sh, size,
+               ms[0], ms[1], ms[2], sw * sh / (ms[2] * 1000.0), differ);
+        free(src);
+        free(ref);
+        free(dst);
+    }
+    if (total[2] > 0) {
+        printf("%-20s %10s %5s %11.4f %11.4f %11.4f %12.1f\n", "all", "", "",
+               total[0], total[1], total[2], pixels / (total[2] * 1000.0));
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    Portrait portraits[MAX_PORTRAITS];
+    AtlasHeader header;
+    AtlasRect rect;
+    unsigned char *src, *pixels;
+    int n = 0, size = 0, width = ATLAS_WIDTH, height, i, y, sw, sh;
+    FILE *out;
+    
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s out.atlas -s size file.ppm ... [-s size file.ppm ...]\n", argv[0]);
+        fprintf(stderr, "       %s -b -s size file.ppm ...   (time the scalers, writes nothing)\n", argv[0]);
+        return 1;
+    }
+    if (strcmp(argv[1], "-b") == 0) return bench(argc - 2, argv + 2);
+    for (i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            size = atoi(argv[++i]);
+            continue;
+        }
+        if (size <= 0) { fprintf(stderr, "packatlas: give -s size before %s\n", argv[i]); return 1; }
+        if (n == MAX_PORTRAITS) { fprintf(stderr, "packatlas: too many portraits\n"); return 1; }
+        src = read_ppm(argv[i], &sw, &sh);
+        if (!src) {
+            fprintf(stderr, "packatlas: skipping %s (missing or not a P6 PPM)\n", argv[i]);
+            continue;
+        }
+        portrait_name(argv[i], portraits[n].name);
+        portraits[n].w = portraits[n].h = size;
+        portraits[n].rgb = resample(src, sw, sh, size, size);
+        free(src);
+        if (!portraits[n].rgb) return 1;
+        if (size > width) width = size;
+        n++;
+    }
+    
+    height = pack_shelves(portraits, n, width);
+    pixels = calloc((size_t)width * (height > 0 ? height : 1), 3);
+    if (!pixels) return 1;
+    for (i = 0; i < n; i++) {
+        for (y = 0; y < portraits[i].h; y++) {
+            memcpy(pixels + ((size_t)(portraits[i].y + y) * width + portraits[i].x) * 3,
+                   portraits[i].rgb + (size_t)y * portraits[i].w * 3, (size_t)portraits[i].w * 3);
+        }
+    }
+    
+    out = fopen(argv[1], "wb");
+    if (!out) { perror(argv[1]); return 1; }
+    memcpy(header.magic, ATLAS_MAGIC, 4);
+    header.count = n;
+    header.width = width;
+    header.height = height;
+    fwrite(&header, sizeof(header), 1, out);
+    for (i = 0; i < n; i++) {
+        memcpy(rect.name, portraits[i].name, ATLAS_NAME_LEN);
+        rect.x = portraits[i].x;
+        rect.y = portraits[i].y;
+        rect.w = portraits[i].w;
+        rect.h = portraits[i].h;
+        fwrite(&rect, sizeof(rect), 1, out);
+        free(portraits[i].rgb);
+    }
+    fwrite(pixels, 3, (size_t)width * height, out);
+    if (fclose(out) != 0) { perror(argv[1]); return 1; }
+    
+    printf("packatlas: %d portraits into %s (%dx%d, %ld bytes)\n", n, argv[1], width, height,
+           (long)(sizeof(header) + n * sizeof(rect) + (size_t)width * height * 3));
+    free(pixels);
+    return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * 3D Flight Shooter - debris particles
+ * Author: Matus Vecera
+ *
+ * See particles.h. The update is split in two passes: first every particle
+ * moves (no ifs at all), then the dead ones are squeezed out by copying every
+ * particle down and only advancing the write index for the live ones.
+ */
+
+#include "particles.h"
+
+// Empty pool
+void particles_init(ParticlePool *p) {
+    p->count = 0;
+    p->rng = 12345u;
+}
+
+// Random float from -1 to 1 (same LCG as game_rand, separate state)
+float particle_rand(ParticlePool *p) {
+    p->rng = p->rng * 1103515245u + 12345u;
+    return (float)((p->rng / 65536u) % 32768u) / 16383.5f - 1.0f;
+}
+
+// Burst of count pieces flying out from (x, y, z) at up to speed units per frame
+// Returns how many fit in the pool
+int particles_spawn(ParticlePool *p, float x, float y, float z, float floor, int count, float speed) {
+    int i, n = p->count;
+    
+    if (count > MAX_PARTICLES - n) count = MAX_PARTICLES - n;
+    for (i = n; i < n + count; i++) {
+        p->x[i] = x;
+        p->y[i] = y;
+        p->z[i] = z;
+        p->vx[i] = particle_rand(p) * speed;
+        p->vy[i] = particle_rand(p) * speed + speed * 0.5f; // a bit upward, it looks like an explosion
+        p->vz[i] = particle_rand(p) * speed;
+        p->floor[i] = floor;
+        p->life[i] = 40.0f + 30.0f * particle_rand(p); // 10 to 70 frames
+    }
+    p->count = n + count;
+    return count;
+}
+
+// Move every particle one frame, then drop the ones that ran out of life or hit the ground
+void particles_update(ParticlePool *p) {
+    int i, j, alive, n = p->count;
+    
+    // Pass 1: integrate, straight float math the compiler vectorizes
+    for (i = 0; i < n; i++) {
+        p->vy[i] -= PARTICLE_GRAVITY;
+        p->x[i] += p->vx[i];
+        p->y[i] += p->vy[i];
+        p->z[i] += p->vz[i];
+        p->life[i] -= 1.0f;
+    }
+    
+    // Pass 2: compact, copy everything down and keep the live ones packed at the front
+    for (i = 0, j = 0; i < n; i++) {
+        alive = (p->life[i] > 0.0f) & (p->y[i] > p->floor[i]);
+        p->x[j] = p->x[i];
+        p->y[j] = p->y[i];
+        p->z[j] = p->z[i];
+        p->vx[j] = p->vx[i];
+        p->vy[j] = p->vy[i];
+        p->vz[j] = p->vz[i];
+        p->floor[j] = p->floor[i];
+        p->life[j] = p->life[i];
+        j += alive;
+    }
+    p->count = j;
+}
+
+// The world origin moved by (dx, dz), move the particles with it
+void particles_shift(ParticlePool *p, float dx, float dz) {
+    int i;
+    
+    for (i = 0; i < p->count; i++) {
+        p->x[i] -= dx;
+        p->z[i] -= dz;
+    }
+}
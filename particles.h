@@ -0,0 +1,31 @@
+/*
+ * 3D Flight Shooter - debris particles
+ * Author: Matus Vecera
+ *
+ * A fixed pool of particles stored as one array per field (structure of arrays),
+ * so the per-frame update is a few straight loops over floats that the compiler
+ * can vectorize. Spawning never allocates, it just fills the next free slots, and
+ * live particles are always packed at the front of the arrays.
+ */
+
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#define MAX_PARTICLES 4096 // live debris pieces, extra spawns are dropped
+#define PARTICLE_GRAVITY 0.08f // downward speed added every frame
+
+typedef struct {
+    float x[MAX_PARTICLES], y[MAX_PARTICLES], z[MAX_PARTICLES];     // position (local coordinates)
+    float vx[MAX_PARTICLES], vy[MAX_PARTICLES], vz[MAX_PARTICLES];  // velocity per frame
+    float floor[MAX_PARTICLES];  // terrain height under the burst, the piece dies below it
+    float life[MAX_PARTICLES];   // frames left
+    int count;                   // particles 0..count-1 are alive
+    unsigned int rng;            // own random numbers, so debris never changes the game's sequence
+} ParticlePool;
+
+void particles_init(ParticlePool *p);
+int particles_spawn(ParticlePool *p, float x, float y, float z, float floor, int count, float speed);
+void particles_update(ParticlePool *p);
+void particles_shift(ParticlePool *p, float dx, float dz);
+
+#endif
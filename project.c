@@ -14,317 +14,544 @@
  *   Q      - Quit
  */
 
-#define _XOPEN_SOURCE 500 // This is for the usleep function
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h> // for usleep
-#include <math.h>
+#include <stddef.h> // for offsetof
+#include <string.h>
+#include <tgmath.h> // sin/cos pick the float versions in the float build
 #include <time.h> // for time()
+#include <pthread.h>
 #include "gfx.h"
+#include "project.h"
 
-/* ==================== CONSTANTS  ==================== */
-#define SCREEN_WIDTH 800
-#define SCREEN_HEIGHT 600
-#define SCREEN_CX 400
-#define SCREEN_CY 300
-#define GRID_SIZE 20
-#define GRID_SPACING 25
-#define RENDER_DISTANCE 1200
-#define RENDER_DIST_SQ (RENDER_DISTANCE * RENDER_DISTANCE)
-#define MAX_OBSTACLES 15
-#define MAX_BULLETS 10
-#define BULLET_SPEED 15.0
-#define WIN_SCORE 1000
-#define PI 3.14159265358979 //I made this becuase PI constant in math libary was being weird
-#define FOV_SCALE 0.8 // Field of view scaling factor
-#define PROJ_DISTANCE 300.0 // Distance from camera to projection plane
-#define START_SPEED 1.5
-
-/* ==================== DATA STRUCTURES ==================== */
-// 3D point structure
-typedef struct {
-    double x, y, z;
-} Point3D;
-
-// Camera structure
-typedef struct {
-    Point3D position;
-    double pitch, yaw; // rotation angles
-    double cos_pitch, sin_pitch, cos_yaw, sin_yaw;  /* precomputed trig */
-    double speed; // movement speed
-} Camera;
-
-// Bullet structure
-typedef struct {
-    Point3D position; //bullet position
-    Point3D velocity; //bullet velocity
-    int active; //1=active, 0=inactive
-} Bullet;
-
-// Obstacle structure
-typedef struct {
-    Point3D position;              
-    double size;
-    double rotation;
-    int active;      
-} Obstacle;
-
-//camera and game state
-typedef struct {
-    Camera camera;
-    Bullet bullets[MAX_BULLETS];
-    Obstacle obstacles[MAX_OBSTACLES];
-    int score;
-    int lives;
-    int is_moving;
-    int show_Win_Screen;  /* unlocked when score >= WIN_SCORE */
-    int game_over;       /* 1 = crashed/died */
-    time_t start_time;   /* when game started */  
-    int final_time;      /* seconds to win (frozen at win) */                  
-} GameState;
-
-/* ==================== FUNCTION DECLARATIONS ==================== */
-
-void init_game(GameState *game);
-void update_camera_trig(Camera *cam);
-void project_point(Point3D p, Camera *cam, int *sx, int *sy);
-double get_terrain_height(GameState *game, double x, double z);
-void draw_sky(void);
-void draw_terrain(GameState *game);
-void draw_win_screen(GameState *game);
-void draw_lose_screen(GameState *game);
-void draw_obstacles(GameState *game);
-void draw_bullets(GameState *game);
-void draw_crosshair(void);
-void draw_hud(GameState *game);
-void update_bullets(GameState *game);
-void update_obstacles(GameState *game);
-void fire_bullet(GameState *game);
-void check_collisions(GameState *game);
-
-/* ==================== MAIN FUNCTION ==================== */
-
-int main(void) {
-    GameState game; // main game state
-    char c;
-    int mouse_x, mouse_y;
-    double target_yaw, target_pitch; // desired camera angles based on mouse
-    double steer_speed = 0.06;  /* How fast camera turns toward mouse */
-    
-    srand(time(NULL)); // Seed random number generator
-    init_game(&game); // Initialize game state
-    
-    gfx_open(SCREEN_WIDTH, SCREEN_HEIGHT, "3D Flight Shooter - Fly toward mouse, Left CLick to shoot!"); //  Open graphics window
-    
-    /* Main game loop */
-    while (1) {
-        // Get mouse position and steer toward it
-        mouse_x = gfx_xpos();
-        mouse_y = gfx_ypos();
-        
-        // Calculate how much to turn based on mouse offset from center
-        // Mouse left of center = turn left (negative yaw change)
-        target_yaw = (mouse_x - SCREEN_CX) * 0.0008;  // Scale mouse offset to rotation
-        target_pitch = (mouse_y - SCREEN_CY) * 0.0006;  // Pitch based on vertical offset
-        
-        // Smoothly steer toward mouse direction
-        game.camera.yaw += target_yaw * steer_speed;
-        game.camera.pitch += target_pitch * steer_speed;
-        
-        // Clamp pitch, which is more limited than yaw
-        if (game.camera.pitch < -1.2) game.camera.pitch = -1.2;
-        if (game.camera.pitch > 0.8) game.camera.pitch = 0.8;
-        
-        // Update trig values (used for movement and rendering)
-        update_camera_trig(&game.camera);
-        
-        // Always move forward - I am flying!
-        game.camera.position.x += game.camera.speed * game.camera.sin_yaw * game.camera.cos_pitch;
-        game.camera.position.z += game.camera.speed * game.camera.cos_yaw * game.camera.cos_pitch;
-        game.camera.position.y += game.camera.speed * game.camera.sin_pitch;
-        
-        // Check ground collision = death
-        {
-            double ground = get_terrain_height(&game, game.camera.position.x, game.camera.position.z) + 15;
-            if (game.camera.position.y < ground) {
-                game.game_over = 1;
-                printf("\a");  // Crash sound
-                printf("\n*** CRASHED INTO GROUND! ***\n");
-            }
-        }
-                             
-        // Check if game over - show lose screen
-        if (game.game_over) {
-            game.final_time = (int)(time(NULL) - game.start_time);
-            printf("*** GAME OVER! ***\n");
-            printf("Final Score: %d\n", game.score);
-            
-            draw_lose_screen(&game);
-            gfx_flush();
-            
-            // Wait for user to quit or restart
-            while (1) {
-                c = gfx_wait();
-                if (c == 'q' || c == 'Q') { //quit
-                    return 0;
-                }
-                if (c == 'r' || c == 'R') { // restart
-                    init_game(&game); // Restart game
-                    gfx_clear_color(0, 0, 0);  /* Reset background to black */
-                    break;  /* Restart game loop */
-                }
-            }
-        }
-        
-        // Check if player won - show win screen
-        if (game.score >= WIN_SCORE && !game.show_Win_Screen) { // won
-            game.show_Win_Screen = 1;
-            game.final_time = (int)(time(NULL) - game.start_time);  // Freeze time
-            printf("\n*** CONGRATULATIONS! You won in %d:%02d! ***\n", game.final_time / 60, game.final_time % 60);
-            printf("*** Press Q to quit, R to restart ***\n\n");
-            
-            // Draw win screen once
-            draw_win_screen(&game);
-            gfx_flush();
-            
-            // Wait for user to quit or restart
-            while (1) {
-                c = gfx_wait();
-                if (c == 'q' || c == 'Q') {
-                    printf("Final Score: %d\n", game.score);
-                    return 0;
-                }
-                if (c == 'r' || c == 'R') {
-                    init_game(&game);
-                    gfx_clear_color(0, 0, 0);  // Reset background to black
-                    break;  // Restart game loop
-                }
-            }
-        }
-        
-        // Update game state
-        update_bullets(&game);
-        update_obstacles(&game);
-        check_collisions(&game);
-        
-        // Draw everything
-        gfx_clear();
-        draw_sky();
-        draw_terrain(&game);
-        draw_obstacles(&game);
-        draw_bullets(&game);
-        draw_crosshair();
-        draw_hud(&game);
-        gfx_flush();
-        
-        usleep(12000);  /* ~80 FPS for smoother animation */
-        
-        /* Handle input */
-        while (gfx_event_waiting()) {
-            c = gfx_wait();
-            
-            if (c == 1) fire_bullet(&game);  /* mouse click = shoot */
-            if (c == 'q' || c == 'Q') {
-                printf("Final Score: %d\n", game.score);
-                return 0;
-            }
-            if (c == '=' || c == '+') {
-                game.camera.speed += 0.5;
-                if (game.camera.speed > 10.0) game.camera.speed = 10.0;
-                printf("Speed: %.1f\n", game.camera.speed);
-            }
-            if (c == '-' || c == '_') {
-                game.camera.speed -= 0.5;
-                if (game.camera.speed < 1.0) game.camera.speed = 1.0;
-                printf("Speed: %.1f\n", game.camera.speed);
-            }
-        }
+/* ==================== INITIALIZATION ==================== */
+
+// Set up display settings and the quality governor, these survive restarts
+// target_ms = 0 keeps the default quality level fixed
+void init_settings(GameState *game, double target_ms) {
+    game->hidden_lines = 0;
+    game->terrain_occlusion = 1;
+    game->view_mode = 0;
+    game->fog = 1;
+    game->terrain_strips = 1;
+    game->governor.target_ms = target_ms;
+    game->governor.sum = 0.0;
+    game->governor.count = 0;
+    game->governor.next = 0;
+    game->governor.average_ms = 0.0;
+    game->hud.score = game->hud.seconds = game->hud.level = -1;
+    set_quality(game, QUALITY_DEFAULT);
+}
+
+/* ==================== QUALITY GOVERNOR ==================== */
+
+// Detail levels from cheapest to finest, QUALITY_DEFAULT is the original game
+static const Quality QUALITY_TABLE[QUALITY_LEVELS] = {
+    {8, 45.0, 450.0, 700.0},
+    {12, 35.0, 700.0, 900.0},
+    {16, 30.0, 950.0, 1200.0},
+    {GRID_SIZE, GRID_SPACING, RENDER_DISTANCE, OBSTACLE_DISTANCE},
+    {26, 22.0, RENDER_DISTANCE, OBSTACLE_DISTANCE},
+    {GRID_SIZE_MAX, 18.0, RENDER_DISTANCE, OBSTACLE_DISTANCE}
+};
+
+// Switch to a quality level (clamped to the table)
+void set_quality(GameState *game, int level) {
+    if (level < 0) level = 0;
+    if (level > QUALITY_LEVELS - 1) level = QUALITY_LEVELS - 1;
+    game->governor.level = level;
+    game->quality = QUALITY_TABLE[level];
+}
+
+// Record one frame's time and step the quality level if the window says so
+// Hysteresis: drop a level when the average is 10% over target, only raise it when
+// there is 40% headroom, and start a fresh window after every change so one
+// decision's effect is measured before the next one.
+void governor_frame(GameState *game, double frame_ms) {
+    Governor *gov = &game->governor;
+    int level = gov->level;
+    
+    if (gov->target_ms <= 0.0) return;
+    
+    if (gov->count == GOVERNOR_WINDOW) gov->sum -= gov->samples[gov->next];
+    else gov->count++;
+    gov->samples[gov->next] = frame_ms;
+    gov->sum += frame_ms;
+    gov->next = (gov->next + 1) % GOVERNOR_WINDOW;
+    if (gov->count < GOVERNOR_WINDOW) return;
+    
+    gov->average_ms = gov->sum / GOVERNOR_WINDOW;
+    if (gov->average_ms > gov->target_ms * 1.1 && level > 0) level--;
+    else if (gov->average_ms < gov->target_ms * 0.6 && level < QUALITY_LEVELS - 1) level++;
+    if (level == gov->level) return;
+    
+    printf("Quality %d -> %d (avg frame %.1f ms, target %.1f ms)\n",
+           gov->level, level, gov->average_ms, gov->target_ms);
+    set_quality(game, level);
+    gov->count = 0;
+    gov->next = 0;
+    gov->sum = 0.0;
+}
+
+
+/* ==================== PROFILING COUNTERS ==================== */
+
+// Names (CSV columns, budget names) and places of the Counters fields
+static const struct {
+    const char *name;
+    size_t offset;
+} COUNTER_FIELDS[COUNTERS] = {
+    {"vertices_projected", offsetof(Counters, vertices_projected)},
+    {"vertices_behind", offsetof(Counters, vertices_behind)},
+    {"segments", offsetof(Counters, segments)},
+    {"segments_offscreen", offsetof(Counters, segments_offscreen)},
+    {"segments_culled", offsetof(Counters, segments_culled)},
+    {"color_changes", offsetof(Counters, color_changes)},
+    {"terrain_heights", offsetof(Counters, terrain_heights)},
+    {"collision_tests", offsetof(Counters, collision_tests)},
+    {"chunks_loaded", offsetof(Counters, chunks_loaded)},
+    {"vertices_submitted", offsetof(Counters, vertices_submitted)}
+};
+
+const char *counter_name(int i) {
+    return COUNTER_FIELDS[i].name;
+}
+
+int counter_value(const Counters *c, int i) {
+    return *(const int *)((const char *)c + COUNTER_FIELDS[i].offset);
+}
+
+// Add every counter in from to the same one in to
+void counters_add(Counters *to, const Counters *from) {
+    int i;
+    for (i = 0; i < COUNTERS; i++) {
+        *(int *)((char *)to + COUNTER_FIELDS[i].offset) += counter_value(from, i);
     }
+}
+
+// Index of the counter with this name, -1 if there is none
+int counter_lookup(const char *name) {
+    int i;
+    for (i = 0; i < COUNTERS; i++) {
+        if (strcmp(name, COUNTER_FIELDS[i].name) == 0) return i;
+    }
+    return -1;
+}
+
+// CSV export: one header line, then one row per frame
+void counters_csv_header(FILE *f) {
+    int i;
+    fprintf(f, "frame,frame_ms");
+    for (i = 0; i < COUNTERS; i++) fprintf(f, ",%s", COUNTER_FIELDS[i].name);
+    fprintf(f, "\n");
+}
+
+void counters_csv_row(FILE *f, int frame, double frame_ms, const Counters *c) {
+    int i;
+    fprintf(f, "%d,%.3f", frame, frame_ms);
+    for (i = 0; i < COUNTERS; i++) fprintf(f, ",%d", counter_value(c, i));
+    fprintf(f, "\n");
+}
+
+/* ==================== FRAME HELPERS ==================== */
+// Both the interactive game and the offline renderer drive the game through these
+
+// Print what happened in the last simulated frame (beeps included)
+void report_events(GameState *game) {
+    int i;
     
+    if (game->events.crashed) {
+        printf("\a");  // Crash sound
+        printf("\n*** CRASHED INTO GROUND! ***\n");
+    }
+    for (i = 0; i < game->events.hits; i++) {
+        printf("\a");  /* Beep jingle for hit! */
+        fflush(stdout);
+        printf("HIT! Score: %d\n", game->score - 100 * (game->events.hits - 1 - i));
+    }
+    if (game->events.hits > 0 && game->score >= WIN_SCORE && game->score - 100 * game->events.hits < WIN_SCORE) {
+        printf("\n*** SCORE %d REACHED! Professor terrain unlocked! ***\n\n", WIN_SCORE);
+    }
+    for (i = 0; i < game->events.collisions; i++) {
+        printf("\a");  /* Crash sound */
+        printf("COLLISION! Lives remaining: %d\n", game->lives + game->events.collisions - 1 - i);
+    }
+    if (game->events.collisions > 0 && game->lives <= 0) {
+        printf("\n*** OUT OF LIVES! ***\n");
+    }
+}
+
+// Apply one key or mouse event, returns 1 if the player asked to quit
+int handle_key(GameState *game, char c) {
+    if (c == 1) fire_bullet(game);  /* mouse click = shoot */
+    if (c == 'q' || c == 'Q') {
+        return 1;
+    }
+    if (c == '=' || c == '+') {
+        game->camera.speed += 0.5;
+        if (game->camera.speed > 10.0) game->camera.speed = 10.0;
+        printf("Speed: %.1f\n", game->camera.speed);
+    }
+    if (c == '-' || c == '_') {
+        game->camera.speed -= 0.5;
+        if (game->camera.speed < 1.0) game->camera.speed = 1.0;
+        printf("Speed: %.1f\n", game->camera.speed);
+    }
+    if (c == 'h' || c == 'H') {
+        game->hidden_lines = !game->hidden_lines;
+        printf("Hidden lines: %s\n", game->hidden_lines ? "removed" : "shown");
+    }
+    if (c == 'o' || c == 'O') {
+        game->terrain_occlusion = !game->terrain_occlusion;
+        printf("Terrain occlusion: %s\n", game->terrain_occlusion ? "on" : "off");
+    }
+    if (c == 'f' || c == 'F') {
+        game->fog = !game->fog;
+        printf("Fog: %s\n", game->fog ? "on" : "off");
+    }
+    if (c == 'l' || c == 'L') {
+        game->terrain_strips = !game->terrain_strips;
+        printf("Terrain lines: %s\n", game->terrain_strips ? "row/column polylines" : "one segment per edge");
+    }
+    if (c == 'v' || c == 'V') {
+        static const char *names[VIEW_MODES] = {"one view", "rear-view mirror", "split screen"};
+        game->view_mode = (game->view_mode + 1) % VIEW_MODES;
+        printf("View: %s\n", names[game->view_mode]);
+    }
     return 0;
 }
 
-/* ==================== INITIALIZATION ==================== */
+// B key (or retry on the lose screen): go back steps snapshots and say how far
+void rewind_game(GameState *game, SnapshotRing *ring, int steps) {
+    steps = snapshot_rewind(ring, game, steps);
+    if (steps < 0) return;
+    printf("Rewind: back %.1f seconds\n", steps * SNAPSHOT_EVERY / 80.0); // ~80 FPS
+}
 
-void init_game(GameState *game) {
+// What the rewind snapshots cost: time per snapshot and the ring's fixed memory
+void report_snapshots(FILE *f, const SnapshotRing *ring) {
+    if (ring->taken == 0) return;
+    fprintf(f, "Snapshots: %d taken, %.0f ns each, ring is %lu KB (%d x %lu bytes)\n",
+            ring->taken, ring->seconds * 1e9 / ring->taken, (unsigned long)sizeof(ring->state) / 1024,
+            SNAPSHOTS, (unsigned long)SNAPSHOT_SIZE);
+}
+
+// Project and cull one view into its draw list, with its own counters
+// No gfx calls and nothing in game is written, so any thread can do it.
+void cull_view(const GameState *game, const TerrainSet *set, ViewJob *job) {
+    int side = 2 * set->grid_size + 1;
+    
+    memset(&job->counters, 0, sizeof(job->counters));
+    job->list.n = 0;
+    project_terrain(set, &job->vp, &job->view);
+    job->counters.vertices_projected += side * side;
+    job->counters.vertices_behind += job->view.behind;
+    draw_sky(&job->vp, &job->list);
+    draw_terrain(game, set, job);
+    draw_obstacles(game, job);
+    draw_bullets(game, job);
+    draw_particles(game, job);
+}
+
+// Take views nobody has started on until there are none left (called with the lock held)
+void take_views(ViewWorkers *w) {
     int i;
-    //set up the initial conditions of the game
-    game->camera.position.x = 0.0; // Start at origin
-    game->camera.position.y = 300.0;  // Start higher
-    game->camera.position.z = 0.0; // Start at origin
-    game->camera.pitch = 0.0;  // Looking straight ahead
-    game->camera.yaw = 0.0; // Facing along +Z axis
-    game->camera.speed = START_SPEED; // Moderate speed
     
-    game->score = 0;
-    game->lives = 3;
-    game->is_moving = 1;
-    game->show_Win_Screen = 0;
-    game->game_over = 0;
-    game->start_time = time(NULL);
-    game->final_time = 0;
+    while (w->next < w->views) {
+        i = w->next++;
+        pthread_mutex_unlock(&w->lock);
+        cull_view(w->game, w->set, &w->jobs[i]);
+        pthread_mutex_lock(&w->lock);
+        w->pending--;
+        pthread_cond_broadcast(&w->cond);
+    }
+}
+
+// View worker: sleep until a frame is handed out, help cull its views, repeat
+void *view_worker(void *arg) {
+    ViewWorkers *w = arg;
+    int frame = 0;
     
-    for (i = 0; i < MAX_BULLETS; i++) { //initialize bullets
-        game->bullets[i].active = 0;
+    pthread_mutex_lock(&w->lock);
+    while (1) {
+        while (w->frame == frame && !w->quit) pthread_cond_wait(&w->cond, &w->lock);
+        if (w->quit) break;
+        frame = w->frame;
+        take_views(w);
     }
-    for (i = 0; i < MAX_OBSTACLES; i++) { //initialize obstacles
-        game->obstacles[i].active = 0;
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+// Start the view workers, they live as long as the game (if none start, the
+// main thread culls every view itself)
+void view_workers_start(ViewWorkers *w) {
+    int i;
+    
+    memset(w, 0, sizeof(*w));
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    for (i = 0; i < MAX_VIEWPORTS - 1; i++) {
+        if (pthread_create(&w->thread[w->threads], NULL, view_worker, w) == 0) w->threads++;
     }
 }
 
-/* ==================== CAMERA & PROJECTION ==================== */
-// Update precomputed trig values for camera
-void update_camera_trig(Camera *cam) {
-    cam->cos_pitch = cos(cam->pitch);
-    cam->sin_pitch = sin(cam->pitch);
-    cam->cos_yaw = cos(cam->yaw);
-    cam->sin_yaw = sin(cam->yaw);
+// Stop and join the view workers and free the draw lists
+void view_workers_stop(ViewWorkers *w) {
+    int i;
+    
+    pthread_mutex_lock(&w->lock);
+    w->quit = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    for (i = 0; i < w->threads; i++) pthread_join(w->thread[i], NULL);
+    for (i = 0; i < MAX_VIEWPORTS; i++) free(w->jobs[i].list.data);
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->lock);
+}
+
+// Cull all n views of this frame: view 0 here, the rest on the workers (and here too
+// once view 0 is done), returns when every view's draw list is ready
+void view_workers_run(ViewWorkers *w, const GameState *game, const TerrainSet *set, const Viewport *vp, int n) {
+    int i;
+    
+    for (i = 0; i < n; i++) w->jobs[i].vp = vp[i];
+    pthread_mutex_lock(&w->lock);
+    w->game = game;
+    w->set = set;
+    w->views = n;
+    w->next = 1;
+    w->pending = n - 1;
+    w->frame++;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    
+    cull_view(game, set, &w->jobs[0]);
+    pthread_mutex_lock(&w->lock);
+    take_views(w);
+    while (w->pending > 0) pthread_cond_wait(&w->cond, &w->lock);
+    pthread_mutex_unlock(&w->lock);
+}
+
+// Draw everything for one frame of play
+// The terrain heights are worked out once, then every viewport is projected and
+// culled into its own draw list, the first one on this thread and the others at
+// the same time on the view workers. Only playing the lists back is serial, gfx
+// is not thread safe.
+// The gfx layer counts lines, points and colors, they go into this frame's counters
+void draw_frame(GameState *game, ViewWorkers *workers) {
+    Counters *c = &game->counters;
+    Viewport vp[MAX_VIEWPORTS];
+    TerrainSet set;
+    int i, n;
+    
+    gfx_counters(&c->segments, &c->segments_offscreen, &c->vertices_submitted, &c->color_changes); // forget anything drawn before this frame
+    n = setup_viewports(game, vp);
+    build_terrain(game, &set);
+    view_workers_run(workers, game, &set, vp, n);
+    
+    gfx_clear();
+    for (i = 0; i < n; i++) {
+        gfx_clip(vp[i].x, vp[i].y, vp[i].w, vp[i].h);
+        if (i > 0) gfx_clear(); // the mirror covers part of the main view
+        draw_list_play(&workers->jobs[i].list);
+        counters_add(c, &workers->jobs[i].counters);
+    }
+    gfx_clip(0, 0, 0, 0);
+    
+    // Frames around the smaller views
+    gfx_color(150, 150, 150);
+    for (i = 0; i < n; i++) {
+        if (vp[i].w == SCREEN_WIDTH && vp[i].h == SCREEN_HEIGHT) continue;
+        gfx_line(vp[i].x, vp[i].y, vp[i].x + vp[i].w - 1, vp[i].y);
+        gfx_line(vp[i].x, vp[i].y + vp[i].h - 1, vp[i].x + vp[i].w - 1, vp[i].y + vp[i].h - 1);
+        gfx_line(vp[i].x, vp[i].y, vp[i].x, vp[i].y + vp[i].h - 1);
+        gfx_line(vp[i].x + vp[i].w - 1, vp[i].y, vp[i].x + vp[i].w - 1, vp[i].y + vp[i].h - 1);
+    }
+    draw_crosshair(&vp[0]);
+    draw_hud(game);
+    gfx_counters(&c->segments, &c->segments_offscreen, &c->vertices_submitted, &c->color_changes);
+}
+
+/* ==================== DRAW LISTS ==================== */
+// The gfx calls for one view, recorded while it is culled and played back later
+// on the main thread. Each call is its DRAW_ code and then its arguments. The
+// list keeps its memory from frame to frame, so it only grows the first few frames.
+
+// Room for count more ints at the end, NULL if there is no memory (the call is dropped)
+int *draw_list_add(DrawList *list, int count) {
+    int size;
+    int *data;
+    
+    if (list->n + count > list->size) {
+        size = list->size * 2 > list->n + count ? list->size * 2 : list->n + count + 4096;
+        data = realloc(list->data, (size_t)size * sizeof(int));
+        if (!data) return NULL;
+        list->data = data;
+        list->size = size;
+    }
+    data = list->data + list->n;
+    list->n += count;
+    return data;
+}
+
+void draw_list_color(DrawList *list, int r, int g, int b) {
+    int *p = draw_list_add(list, 4);
+    
+    if (!p) return;
+    p[0] = DRAW_COLOR;
+    p[1] = r;
+    p[2] = g;
+    p[3] = b;
+}
+
+void draw_list_line(DrawList *list, int x1, int y1, int x2, int y2) {
+    int *p = draw_list_add(list, 5);
+    
+    if (!p) return;
+    p[0] = DRAW_LINE;
+    p[1] = x1;
+    p[2] = y1;
+    p[3] = x2;
+    p[4] = y2;
+}
+
+void draw_list_circle(DrawList *list, int x, int y, int r) {
+    int *p = draw_list_add(list, 4);
+    
+    if (!p) return;
+    p[0] = DRAW_CIRCLE;
+    p[1] = x;
+    p[2] = y;
+    p[3] = r;
 }
 
+// n segments, x1,y1,x2,y2 each
+void draw_list_segments(DrawList *list, const int *xy, int n) {
+    int *p = draw_list_add(list, 2 + 4 * n);
+    
+    if (!p) return;
+    p[0] = DRAW_SEGMENTS;
+    p[1] = n;
+    memcpy(p + 2, xy, (size_t)n * 4 * sizeof(int));
+}
 
-// Project a 3D point to 2D screen coordinates
-void project_point(Point3D p, Camera *cam, int *sx, int *sy) {
-    double dx, dy, dz;
-    double rx, ry, rz, ty, tz;
-    double scale;
+// A polyline through n points
+void draw_list_polyline(DrawList *list, const int *xy, int n) {
+    int *p = draw_list_add(list, 2 + 2 * n);
     
-    // Translate to camera space
-    dx = p.x - cam->position.x; // make sure that i get the relative position to the camera for these coordinates
-    dy = p.y - cam->position.y;
-    dz = p.z - cam->position.z;
+    if (!p) return;
+    p[0] = DRAW_POLYLINE;
+    p[1] = n;
+    memcpy(p + 2, xy, (size_t)n * 2 * sizeof(int));
+}
+
+// Make every recorded call, in order (main thread only)
+void draw_list_play(const DrawList *list) {
+    const int *p = list->data, *end = list->data + list->n;
+    
+    while (p < end) {
+        switch (p[0]) {
+        case DRAW_COLOR: gfx_color(p[1], p[2], p[3]); p += 4; break;
+        case DRAW_LINE: gfx_line(p[1], p[2], p[3], p[4]); p += 5; break;
+        case DRAW_CIRCLE: gfx_circle(p[1], p[2], p[3]); p += 4; break;
+        case DRAW_SEGMENTS: gfx_segments(p + 2, p[1]); p += 2 + 4 * p[1]; break;
+        default: gfx_polyline(p + 2, p[1]); p += 2 + 2 * p[1]; break; // DRAW_POLYLINE
+        }
+    }
+}
+
+/* ==================== CAMERA & PROJECTION ==================== */
+
+// Rotate a camera-relative vector into camera space (yaw, then pitch)
+void camera_rotate(const Camera *cam, real x, real y, real z, Point3D *out) {
+    real rx, rz;
     
     // Rotate by yaw
-    rx = dx * cam->cos_yaw - dz * cam->sin_yaw;
-    rz = dx * cam->sin_yaw + dz * cam->cos_yaw;
-    ry = dy;
+    rx = x * cam->cos_yaw - z * cam->sin_yaw;
+    rz = x * cam->sin_yaw + z * cam->cos_yaw;
     
     // Rotate by pitch
-    ty = ry; // temporary y
-    tz = rz; //
-    ry = ty * cam->cos_pitch - tz * cam->sin_pitch;
-    rz = ty * cam->sin_pitch + tz * cam->cos_pitch;
+    out->x = rx;
+    out->y = y * cam->cos_pitch - rz * cam->sin_pitch;
+    out->z = y * cam->sin_pitch + rz * cam->cos_pitch;
+}
+
+// Fill in the viewports for the current view mode, returns how many there are
+// The first one is always the player's view, the crosshair goes in its middle
+int setup_viewports(GameState *game, Viewport *vp) {
+    Viewport *back = &vp[1];
+    
+    vp[0].x = 0; vp[0].y = 0;
+    vp[0].w = SCREEN_WIDTH; vp[0].h = SCREEN_HEIGHT;
+    vp[0].cx = SCREEN_CX; vp[0].cy = SCREEN_CY;
+    vp[0].fov = FOV_SCALE;
+    vp[0].mirror = 0;
+    vp[0].sun = 1;
+    vp[0].camera = game->camera;
+    if (game->view_mode == 0) return 1;
+    
+    // Looking backwards: turned around, and nose down in front is nose up behind
+    back->camera = game->camera;
+    back->camera.yaw += PI;
+    back->camera.pitch = -back->camera.pitch;
+    update_camera_trig(&back->camera);
+    back->sun = 0;
     
-    // Perspective projection - mark behind-camera points as off-screen
-    if (rz < 20.0) {
+    if (game->view_mode == 1) { // mirror at the top middle, same angle of view as the main view
+        back->w = 240; back->h = 90;
+        back->x = SCREEN_CX - back->w / 2; back->y = 45;
+        back->fov = FOV_SCALE * back->w / SCREEN_WIDTH;
+        back->mirror = 1;
+    } else { // split screen: front on top, back below
+        vp[0].h = SCREEN_HEIGHT / 2;
+        vp[0].cy = steer_center_y(game); // the crosshair, steering is neutral there
+        back->w = SCREEN_WIDTH; back->h = SCREEN_HEIGHT / 2;
+        back->x = 0; back->y = SCREEN_HEIGHT / 2;
+        back->fov = FOV_SCALE;
+        back->mirror = 0;
+    }
+    back->cx = back->x + back->w / 2;
+    back->cy = back->y + back->h / 2;
+    return 2;
+}
+
+// Perspective-project a point that is already in the viewport's camera space
+void project_camera_space(const Viewport *vp, Point3D c, int *sx, int *sy) {
+    real scale;
+    
+    // Mark behind-camera points as off-screen
+    if (c.z < 20.0) {
         *sx = -9999;  // Mark as invalid/behind camera
         *sy = -9999;
         return;
     }
-    scale = PROJ_DISTANCE / rz * FOV_SCALE; // FOV scaling, which stands for field of view, makes things look less distorted
+    scale = PROJ_DISTANCE / c.z * vp->fov; // FOV scaling, which stands for field of view, makes things look less distorted
     
-    *sx = (int)(rx * scale) + SCREEN_CX; // center on screen
-    *sy = (int)(-ry * scale) + SCREEN_CY; // invert y for screen coords
+    if (vp->mirror) *sx = vp->cx - (int)(c.x * scale);
+    else *sx = (int)(c.x * scale) + vp->cx; // center on the viewport
+    *sy = (int)(-c.y * scale) + vp->cy; // invert y for screen coords
 }
 
+// Project a 3D point to 2D screen coordinates in a viewport
+void project_point(Point3D p, const Viewport *vp, int *sx, int *sy) {
+    const Camera *cam = &vp->camera;
+    Point3D c;
+    
+    // Translate to camera space, make sure that i get the relative position to the camera for these coordinates
+    camera_rotate(cam, p.x - cam->position.x, p.y - cam->position.y, p.z - cam->position.z, &c);
+    project_camera_space(vp, c, sx, sy);
+}
 
 
 
 /* ==================== SKY BACKGROUND ==================== */
 
 // Draw simple sky with sun and rays
-void draw_sky(void) {
+void draw_sky(const Viewport *vp, DrawList *out) {
     int i;
-    int horizon = SCREEN_CY + 50;  /* Horizon line position */
+    int horizon = vp->cy + 50;  /* Horizon line position */
+    int sunX = vp->x + vp->w - 150, sunY = vp->y + 80;
     /* Precomputed sun ray endpoints (8 rays at 45 degree intervals) */
     static const int ray_dx[] = {45, 31, 0, -31, -45, -31, 0, 31};
     static const int ray_dy[] = {0, 31, 45, 31, 0, -31, -45, -31};
@@ -332,247 +559,489 @@ void draw_sky(void) {
     static const int ray2_dy[] = {0, 42, 60, 42, 0, -42, -60, -42};
     
     // Draw gradient horizon lines (wireframe style)
-    gfx_color(30, 30, 80);  // Dark blue at top
-    for (i = 0; i < horizon; i += 40) {
-        gfx_line(0, i, SCREEN_WIDTH, i);
+    draw_list_color(out, 30, 30, 80);  // Dark blue at top
+    for (i = vp->y; i < horizon && i < vp->y + vp->h; i += 40) {
+        draw_list_line(out, vp->x, i, vp->x + vp->w, i);
     }
+    if (!vp->sun) return;
     
     // Draw a simple wireframe sun (top right)
-    gfx_color(255, 200, 50);  // Yellow/orange
-    gfx_circle(650, 80, 40);  // Sun circle
-    gfx_circle(650, 80, 35);  // Inner ring
+    draw_list_color(out, 255, 200, 50);  // Yellow/orange
+    draw_list_circle(out, sunX, sunY, 40);  // Sun circle
+    draw_list_circle(out, sunX, sunY, 35);  // Inner ring
     
     // Sun rays (precomputed)
     for (i = 0; i < 8; i++) {
-        gfx_line(650 + ray_dx[i], 80 + ray_dy[i], 650 + ray2_dx[i], 80 + ray2_dy[i]);
+        draw_list_line(out, sunX + ray_dx[i], sunY + ray_dy[i], sunX + ray2_dx[i], sunY + ray2_dy[i]);
     }
 }
 
 
+/* ==================== DEPTH FOG ==================== */
+// Lines fade with distance: the distance picks one of FOG_BUCKETS shades, from the
+// full color (close) down to a fifth of it (as far as anything is drawn). Segments
+// are collected per shade and each shade is drawn with one gfx_color, so the fog
+// costs a dozen color changes per kind of thing per frame instead of one per line.
+// A shade can also hold polylines (strips), the terrain sends its grid lines that way.
+
+// Start collecting segments of one color into out, levels = FOG_BUCKETS (fog on) or 1 (off)
+void fog_begin(FogBatch *fog, DrawList *out, int levels, int r, int g, int b) {
+    int k;
+    
+    fog->out = out;
+    fog->levels = levels;
+    fog->r = r;
+    fog->g = g;
+    fog->b = b;
+    for (k = 0; k < FOG_BUCKETS; k++) fog->n[k] = fog->strips[k] = fog->points[k] = 0;
+}
+
+// Shade (0 to levels-1) for something dist away, max_dist = the furthest anything of its
+// kind is drawn. The one rule for everything, the terrain uses it before it has a batch.
+int fog_shade(int levels, double dist, double max_dist) {
+    int k = (int)(dist / max_dist * levels);
+    
+    if (k < 0) k = 0;
+    if (k > levels - 1) k = levels - 1;
+    return k;
+}
+
+// Shade in this batch for something dist away
+int fog_bucket(const FogBatch *fog, double dist, double max_dist) {
+    return fog_shade(fog->levels, dist, max_dist);
+}
+
+// Send the segments and strips waiting in one shade to the draw list and empty it
+void fog_draw_shade(FogBatch *fog, int k) {
+    double bright = 1.0 - 0.8 * k / (FOG_BUCKETS - 1);
+    const int *xy = fog->strip_xy[k];
+    int i;
+    
+    if (fog->n[k] == 0 && fog->strips[k] == 0) return;
+    draw_list_color(fog->out, (int)(fog->r * bright), (int)(fog->g * bright), (int)(fog->b * bright));
+    if (fog->n[k] > 0) draw_list_segments(fog->out, fog->xy[k], fog->n[k]);
+    for (i = 0; i < fog->strips[k]; i++) {
+        draw_list_polyline(fog->out, xy, fog->strip_len[k][i]);
+        xy += fog->strip_len[k][i] * 2;
+    }
+    fog->n[k] = fog->strips[k] = fog->points[k] = 0;
+}
+
+void fog_add(FogBatch *fog, int shade, int x1, int y1, int x2, int y2) {
+    int *p = fog->xy[shade] + fog->n[shade] * 4;
+    
+    p[0] = x1;
+    p[1] = y1;
+    p[2] = x2;
+    p[3] = y2;
+    if (++fog->n[shade] == FOG_BATCH) fog_draw_shade(fog, shade); // full, it goes out early
+}
+
+// Queue a polyline through n points (n <= FOG_STRIP_POINTS), a lone edge is queued as a segment
+void fog_strip(FogBatch *fog, int shade, const int *xy, int n) {
+    if (n < 2) return;
+    if (n == 2) {
+        fog_add(fog, shade, xy[0], xy[1], xy[2], xy[3]);
+        return;
+    }
+    if (fog->strips[shade] == FOG_STRIPS || fog->points[shade] + n > FOG_STRIP_POINTS) {
+        fog_draw_shade(fog, shade); // no room, what is there goes out early
+    }
+    memcpy(fog->strip_xy[shade] + fog->points[shade] * 2, xy, n * 2 * sizeof(int));
+    fog->strip_len[shade][fog->strips[shade]++] = n;
+    fog->points[shade] += n;
+}
+
+// Send everything collected, far shades first so near lines end up on top
+void fog_flush(FogBatch *fog) {
+    int k;
+    
+    for (k = fog->levels - 1; k >= 0; k--) fog_draw_shade(fog, k);
+}
+
+
+
 /* ==================== TERRAIN ==================== */
 
-// Simple procedural terrain height function
-double get_terrain_height(GameState *game, double x, double z) {
-    (void)game;  // unused parameter
-    // Sine wave terrain
-    return 30.0 * sin(x * 0.01) * sin(z * 0.01) +
-           15.0 * sin(x * 0.03 + z * 0.02);
-}
-
-// Draw wireframe terrain grid
-void draw_terrain(GameState *game) {
-    int i, j, x1, y1, x2, y2; // screen coords
-    double baseX, baseZ, wx, wz, h1, h2; // world coords
-    double dx, dz, distSq; // distance squared
-    Point3D p1, p2; // 3D points
-    int gridSize; // grid size
-    double spacing; // grid spacing
-    double camX = game->camera.position.x; // camera position
-    double camZ = game->camera.position.z; // camera position
-    
-    spacing = GRID_SPACING;
-    gridSize = GRID_SIZE;
-    
-    baseX = ((int)(camX / spacing)) * spacing; // base grid cell X
-    baseZ = ((int)(camZ / spacing)) * spacing; // base grid cell Z
-    
-    for (i = -gridSize; i < gridSize; i++) { // for each grid line in X direction
-        for (j = -gridSize; j < gridSize; j++) { // for each grid line in Z direction
-            wx = baseX + i * spacing; // world X
-            wz = baseZ + j * spacing; // world Z
-            
-            dx = wx - camX; // horizontal distance from camera
-            dz = wz - camZ; // horizontal distance from camera
-            distSq = dx * dx + dz * dz; // squared distance
-            if (distSq > RENDER_DIST_SQ) continue; // skip if too far
-            
-            h1 = get_terrain_height(game, wx, wz); // height at this grid point
-            
-            gfx_color(100, 255, 100);  /* Green terrain */
-            
-            /* Draw X-direction line */
-            h2 = get_terrain_height(game, wx + spacing, wz); // height at next grid point
-            p1.x = wx; p1.y = h1; p1.z = wz; // first point
-            p2.x = wx + spacing; p2.y = h2; p2.z = wz; // second point
-            project_point(p1, &game->camera, &x1, &y1); // project first point
-            project_point(p2, &game->camera, &x2, &y2); // project second point
-            /* Only draw if both points are in front of camera */
-            if (x1 > -9000 && x2 > -9000 && // both points valid
-                (x1 > -200 && x1 < SCREEN_WIDTH + 200) &&  // first point on screen
-                (x2 > -200 && x2 < SCREEN_WIDTH + 200)) { // second point on screen
-                gfx_line(x1, y1, x2, y2); // draw line
-            }
-            
-            /* Draw Z-direction line */
-            h2 = get_terrain_height(game, wx, wz + spacing); // height at next grid point
-            p2.x = wx; p2.y = h2; p2.z = wz + spacing; // second point
-            project_point(p2, &game->camera, &x2, &y2); // project second point
-            /* Only draw if both points are in front of camera */
-            if (x1 > -9000 && x2 > -9000 && // both points valid
-                (x1 > -200 && x1 < SCREEN_WIDTH + 200) &&  // first point on screen
-                (x2 > -200 && x2 < SCREEN_WIDTH + 200)) { // second point on screen
-                gfx_line(x1, y1, x2, y2); // draw line
-            }
+// Work out every terrain vertex around the camera once for this frame
+// Grid lines sit on world multiples of spacing, wherever the origin has moved to.
+// near says whether the vertex passes the render distance test, an edge is only
+// drawn when its lower-index endpoint is near (same rule as the old grid loop).
+void build_terrain(GameState *game, TerrainSet *set) {
+    int i, j, side, gridSize = game->quality.grid_size;
+    double spacing = game->quality.grid_spacing;
+    double maxDistSq = game->quality.render_distance * game->quality.render_distance;
+    double reach = fmin(game->quality.render_distance, gridSize * spacing * sqrt(2.0)); // farthest vertex fog sees
+    double baseX, baseZ, offX, offZ;
+    real dx, dz;
+    
+    offX = fmod(game->origin_x, spacing);
+    offZ = fmod(game->origin_z, spacing);
+    baseX = ((int)((game->camera.position.x + offX) / spacing)) * spacing - offX; // base grid cell X
+    baseZ = ((int)((game->camera.position.z + offZ) / spacing)) * spacing - offZ; // base grid cell Z
+    
+    set->grid_size = gridSize;
+    side = 2 * gridSize + 1;
+    for (i = 0; i < side; i++) {
+        set->x[i] = baseX + (i - gridSize) * spacing; // world X
+        set->z[i] = baseZ + (i - gridSize) * spacing; // world Z
+    }
+    for (j = 0; j < side; j++) {
+        for (i = 0; i < side; i++) {
+            dx = set->x[i] - game->camera.position.x;
+            dz = set->z[j] - game->camera.position.z;
+            set->near[j * side + i] = (dx * dx + dz * dz <= maxDistSq);
+            set->height[j * side + i] = get_terrain_height(game, set->x[i], set->z[j]);
+            set->shade[j * side + i] = game->fog ? fog_shade(FOG_BUCKETS, sqrt(dx * dx + dz * dz), reach) : 0;
         }
     }
+}
+
+// Project every terrain vertex into one viewport (no drawing, safe on any thread)
+void project_terrain(const TerrainSet *set, const Viewport *vp, TerrainView *view) {
+    int k, side = 2 * set->grid_size + 1;
+    Point3D p;
     
-    gfx_color(255, 255, 255);
+    view->behind = 0;
+    for (k = 0; k < side * side; k++) {
+        p.x = set->x[k % side]; p.y = set->height[k]; p.z = set->z[k / side];
+        project_point(p, vp, &view->sx[k], &view->sy[k]);
+        if (view->sx[k] == -9999) view->behind++;
+    }
 }
 
+// Height of the grid vertex nearest to world (x, z), clamped to the grid
+// (get_terrain_height without the counter, so it is safe on a view worker)
+real terrain_height_near(const TerrainSet *set, real x, real z) {
+    int side = 2 * set->grid_size + 1;
+    real spacing = set->x[1] - set->x[0];
+    int i = (int)floor((x - set->x[0]) / spacing + (real)0.5);
+    int j = (int)floor((z - set->z[0]) / spacing + (real)0.5);
+    
+    if (i < 0) i = 0;
+    if (i > side - 1) i = side - 1;
+    if (j < 0) j = 0;
+    if (j > side - 1) j = side - 1;
+    return set->height[j * side + i];
+}
 
+// Copy out one row of projected vertices (constant index u along the traversal axis)
+void terrain_row(const TerrainSet *set, const TerrainView *view, int u, int alongX, TerrainRow *row) {
+    int v, k, gridSize = set->grid_size, side = 2 * gridSize + 1;
+    
+    for (v = 0; v < side; v++) {
+        k = alongX ? v * side + u + gridSize : (u + gridSize) * side + v;
+        row->x[v] = view->sx[k];
+        row->y[v] = view->sy[k];
+        row->near[v] = set->near[k];
+        row->shade[v] = set->shade[k];
+    }
+}
 
-/* ==================== WIN SCREEN ==================== */
+// Hand a finished polyline to the fog batch and start the chain again empty
+void chain_end(FogBatch *fog, TerrainChain *chain) {
+    fog_strip(fog, chain->shade, chain->xy, chain->n);
+    chain->n = 0;
+}
 
-// Helper function to draw a scaled PPM image at position
-void draw_ppm_scaled(const char *filename, int destX, int destY, int destW, int destH) {
-    FILE *file;
-    char magic[3]; // PPM magic number
-    int width, height, maxval, c, x, y; // loop vars
-    int r, g, b;
-    unsigned char *imgR, *imgG, *imgB;
-    double scaleX, scaleY;
-    int srcX, srcY, dx, dy;
-    
-    file = fopen(filename, "rb"); //means reading binary
-    if (!file) return;
-    
-    /* Read PPM header */
-    if (fscanf(file, "%2s", magic) != 1) { fclose(file); return; }
-    // Read magic number (e.g., "P6")
-    /* Skip comments */
-    c = fgetc(file);
-    while (c == '#' || c == '\n' || c == ' ') {
-        if (c == '#') while (fgetc(file) != '\n');
-        c = fgetc(file);
-    }
-    ungetc(c, file);
-    
-    if (fscanf(file, "%d %d %d", &width, &height, &maxval) != 3) { fclose(file); return; }
-    fgetc(file);
-    
-    // Allocate memory for image, the reason that I use malloc instead of a static array is that the image size can vary, and malloc allows for dynamic allocation based on the image dimensions
-    // If the image is too large, then the static array may exceed stack size, so we use heap allocation instead
-    imgR = malloc(width * height);
-    imgG = malloc(width * height);
-    imgB = malloc(width * height);
-    if (!imgR || !imgG || !imgB) { fclose(file); return; }
-    
-    /* Read pixel data */
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-            r = fgetc(file);
-            g = fgetc(file);
-            b = fgetc(file);
-            imgR[y * width + x] = (unsigned char)r;
-            imgG[y * width + x] = (unsigned char)g;
-            imgB[y * width + x] = (unsigned char)b;
-        }
+// Queue one visible piece of terrain line
+// chain = NULL queues it as a segment of its own (the old way). Otherwise it extends
+// the chain when it carries on from the chain's last point in the same shade, and
+// anything else (a gap from a clipped or rejected edge, a new shade) ends the chain
+// and starts a new one, so each grid line goes out as few long polylines.
+void terrain_emit(FogBatch *fog, TerrainChain *chain, int shade, int x1, int y1, int x2, int y2) {
+    if (!chain) {
+        fog_add(fog, shade, x1, y1, x2, y2);
+        return;
     }
-    fclose(file);
+    if (chain->n == 0 || chain->shade != shade || chain->n == TERRAIN_SIDE_MAX + 1 ||
+        chain->xy[chain->n * 2 - 2] != x1 || chain->xy[chain->n * 2 - 1] != y1) {
+        chain_end(fog, chain);
+        chain->shade = shade;
+        chain->xy[0] = x1;
+        chain->xy[1] = y1;
+        chain->n = 1;
+    }
+    chain->xy[chain->n * 2] = x2;
+    chain->xy[chain->n * 2 + 1] = y2;
+    chain->n++;
+}
+
+// Draw the parts of a terrain segment that are not below the floating horizon
+// The segment is walked one pixel at a time along its longer screen axis. A sample
+// is hidden when it lies below horizon[x] (screen y grows downwards), runs of visible
+// samples are drawn as sub-segments, and every sample raises next_horizon.
+// Passing horizon = NULL draws the whole segment (occlusion off).
+// The horizon arrays have one entry per column of the viewport.
+// What is visible goes into the fog batch in the given shade, through chain (see terrain_emit).
+// A segment rejected up front (behind the camera or far off screen) is counted as culled.
+void draw_terrain_segment(const Viewport *vp, FogBatch *fog, TerrainChain *chain, Counters *counters, int shade,
+                          int x1, int y1, int x2, int y2, const int *horizon, int *next_horizon) {
+    int dx = x2 - x1, dy = y2 - y1;
+    int n, k, x, y, visible;
+    int runX = 0, runY = 0, lastX = 0, lastY = 0, inRun = 0;
     
-    /* Draw scaled image */
-    scaleX = (double)width / destW;
-    scaleY = (double)height / destH;
+    /* Only draw if both points are in front of camera and roughly on screen */
+    if (x1 < -9000 || x2 < -9000 ||
+        x1 <= vp->x - 200 || x1 >= vp->x + vp->w + 200 || x2 <= vp->x - 200 || x2 >= vp->x + vp->w + 200) {
+        counters->segments_culled++;
+        return;
+    }
     
-    // Draw each pixel in destination, we use 1d arrays here for each color
-    for (dy = 0; dy < destH; dy++) {
-        for (dx = 0; dx < destW; dx++) {
-            srcX = (int)(dx * scaleX); // source X coordinate in original image
-            srcY = (int)(dy * scaleY);
-            if (srcX >= width) srcX = width - 1;
-            if (srcY >= height) srcY = height - 1;
-            
-            gfx_color(imgR[srcY * width + srcX],
-                      imgG[srcY * width + srcX],
-                      imgB[srcY * width + srcX]);
-            gfx_point(destX + dx, destY + dy);
-        }
+    if (!horizon) {
+        terrain_emit(fog, chain, shade, x1, y1, x2, y2);
+        return;
     }
     
-    //free up the memory when Im done with it
-    free(imgR);
-    free(imgG);
-    free(imgB);
+    n = abs(dx) > abs(dy) ? abs(dx) : abs(dy);
+    if (n > 2 * (vp->w + 400)) n = 2 * (vp->w + 400);  /* still < 1 px per column */
+    if (n == 0) n = 1;
+    
+    for (k = 0; k <= n; k++) {
+        x = x1 + (int)((long)dx * k / n);
+        y = y1 + (int)((long)dy * k / n);
+        
+        visible = 1;
+        if (x >= vp->x && x < vp->x + vp->w) {
+            visible = (y <= horizon[x - vp->x]);
+            if (y < next_horizon[x - vp->x]) next_horizon[x - vp->x] = y;
+        }
+        
+        if (visible) {
+            if (!inRun) { runX = x; runY = y; inRun = 1; }
+            lastX = x; lastY = y;
+        } else if (inRun) {
+            terrain_emit(fog, chain, shade, runX, runY, lastX, lastY);
+            inRun = 0;
+        }
+    }
+    if (inRun) terrain_emit(fog, chain, shade, runX, runY, lastX, lastY);
 }
 
-// Draw the win screen with professor and TAs
-void draw_win_screen(GameState *game) {
-    int profSize = 220;  /* Professor image size - even bigger */
-    int taSize = 95;     // TA image size
-    int profX, profY;
-    int i;
+// Draw what reaching row u adds, walking away from the camera: the connectors back to
+// prev (the row drawn before it on the same side, NULL for none) and the segments along u.
+// Edges are owned by their lower-index vertex, prev_lower says whether that is prev.
+void terrain_advance(const Viewport *vp, FogBatch *fog, Counters *counters, int gridSize, int u,
+                     const TerrainRow *prev, int prev_lower, const TerrainRow *cur, TerrainChain *row,
+                     TerrainChain *columns, const int *clip, int *next_horizon) {
+    const TerrainRow *owner = prev_lower ? prev : cur;
+    int v;
     
-    // TA filenames - 14 TAs
-    const char *ta_files[] = {
-        "693d9e2026f2d.ppm", "693d9e7737592.ppm", "asvenss2.ppm", "cmassman.ppm",
-        "fdrake.ppm", "hflick.ppm", "jnkouka.ppm", "maiyener.ppm",
-        "mbriamon.ppm", "mzitella.ppm", "schou2.ppm", "sco.ppm",
-        "sdevared.ppm", "thieber.ppm"
-    };
-    int numTAs = 14;
-    
-    // Clear to dark blue
-    gfx_clear_color(20, 20, 50);
-    gfx_clear();
+    /* Connectors back to the previous (nearer) row */
+    if (prev) {
+        for (v = 0; v < 2 * gridSize; v++) {
+            if (owner->near[v]) {
+                draw_terrain_segment(vp, fog, columns ? &columns[v] : NULL, counters, owner->shade[v],
+                                     prev->x[v], prev->y[v], cur->x[v], cur->y[v], clip, next_horizon);
+            }
+        }
+    }
     
-    // Draw "Thank you" text at top - single line
-    gfx_color(255, 255, 0);  // Yellow text
-    gfx_text(SCREEN_WIDTH/2 - 250, 25, "Thank you Professor Ramzi and all TAs for a wonderful semester!");
+    /* Segments along this row */
+    if (u != gridSize) {
+        for (v = 0; v < 2 * gridSize; v++) {
+            if (cur->near[v]) {
+                draw_terrain_segment(vp, fog, row, counters, cur->shade[v], cur->x[v], cur->y[v],
+                                     cur->x[v + 1], cur->y[v + 1], clip, next_horizon);
+            }
+        }
+        if (row) chain_end(fog, row);
+    }
+}
+
+// Draw wireframe terrain grid in one viewport, from the shared vertices
+// Grid rows run across whichever world axis the view faces most and are walked front
+// to back: outward from the camera, both ways at once. The edge columns of a wide
+// view can look back along that axis, and there the rows behind the camera are the
+// near ones. With occlusion on, a per-column floating horizon (the highest screen
+// point drawn so far) hides anything behind nearer ridges: each step is clipped
+// against the horizon of the rows in front of it, then merged into it. A screen
+// column only ever sees ground on one side of the camera, so the two sides can
+// share one horizon.
+// Each edge gets the fog shade of the vertex that owns it.
+// With terrain_strips on, the edges are strung into polylines as they come: one
+// chain for the row being drawn and one per column and side, which carries on from row to row.
+void draw_terrain(const GameState *game, const TerrainSet *set, ViewJob *job) {
+    TerrainRow ahead[2], behind[2]; // rows past the camera and rows before it, current and previous
+    int horizon[SCREEN_WIDTH], next_horizon[SCREEN_WIDTH];
+    TerrainChain row, columns[2][TERRAIN_SIDE_MAX];
+    const Viewport *vp = &job->vp;
+    const TerrainView *view = &job->view;
+    FogBatch *fog = &job->fog;
+    int strips = game->terrain_strips;
+    int *clip = game->terrain_occlusion ? horizon : NULL;
+    int u, v, x, k, cur, last;
+    int gridSize = set->grid_size; // grid size
+    int alongX = fabs(vp->camera.sin_yaw) > fabs(vp->camera.cos_yaw); // rows advance along X
+    const real *rows = alongX ? set->x : set->z;
+    real lean = 0, split;
     
-    // Draw professor in center (bigger)
-    profX = SCREEN_WIDTH/2 - profSize/2;
-    profY = SCREEN_HEIGHT/2 - profSize/2 + 5;
-    draw_ppm_scaled("ramzinew.ppm", profX, profY, profSize, profSize);
+    // Where the ground is at depth 0: under the camera when it looks level, behind it when
+    // it looks down. Every screen column sees the ground from there outward, so the rows
+    // split there. The columns that run almost along the rows are thrown by a few units
+    // of error, so it is settled against the height of the ground it lands on.
+    for (k = 0; k < 3; k++) {
+        lean = (vp->camera.position.y - terrain_height_near(set, vp->camera.position.x + lean * vp->camera.sin_yaw,
+                                                             vp->camera.position.z + lean * vp->camera.cos_yaw)) *
+               vp->camera.sin_pitch / vp->camera.cos_pitch;
+    }
+    split = alongX ? vp->camera.position.x + lean * vp->camera.sin_yaw : vp->camera.position.z + lean * vp->camera.cos_yaw;
     
-    // Gold border around professor
-    gfx_color(255, 215, 0);
-    gfx_line(profX - 3, profY - 3, profX + profSize + 3, profY - 3);
-    gfx_line(profX + profSize + 3, profY - 3, profX + profSize + 3, profY + profSize + 3);
-    gfx_line(profX + profSize + 3, profY + profSize + 3, profX - 3, profY + profSize + 3);
-    gfx_line(profX - 3, profY + profSize + 3, profX - 3, profY - 3);
+    // last = the last row at or before the split (-gridSize - 1 when it is past them all)
+    last = -gridSize - 1;
+    while (last < gridSize && rows[last + 1 + gridSize] <= split) last++;
     
-    // Draw TAs around the professor - use more space
-    // Top row: 5 TAs
-    for (i = 0; i < 5 && i < numTAs; i++) {
-        int x = 25 + i * (taSize + 40);
-        int y = 50;
-        draw_ppm_scaled(ta_files[i], x, y, taSize, taSize);
+    for (x = 0; x < vp->w; x++) {
+        horizon[x] = vp->y + vp->h;
+        next_horizon[x] = vp->y + vp->h;
     }
     
-    // Left column: 2 TAs
-    for (i = 0; i < 2; i++) {
-        int x = 25;
-        int y = 160 + i * (taSize + 15);
-        if (5 + i < numTAs) {
-            draw_ppm_scaled(ta_files[5 + i], x, y, taSize, taSize);
+    fog_begin(fog, &job->list, game->fog ? FOG_BUCKETS : 1, 100, 255, 100);  /* Green terrain */
+    row.n = 0;
+    for (v = 0; v < 2 * gridSize + 1; v++) columns[0][v].n = columns[1][v].n = 0;
+    
+    // Step k draws row last - k and row last + 1 + k. The connectors between the two rows
+    // either side of the camera come with the first step, on the side ahead of it.
+    for (k = 0; last - k >= -gridSize || last + 1 + k <= gridSize; k++) {
+        cur = k & 1;
+        u = last - k;
+        if (u >= -gridSize) {
+            terrain_row(set, view, u, alongX, &behind[cur]);
+            terrain_advance(vp, fog, &job->counters, gridSize, u, k > 0 ? &behind[!cur] : NULL, 0, &behind[cur],
+                            strips ? &row : NULL, strips ? columns[0] : NULL, clip, next_horizon);
         }
+        u = last + 1 + k;
+        if (u <= gridSize) {
+            terrain_row(set, view, u, alongX, &ahead[cur]);
+            terrain_advance(vp, fog, &job->counters, gridSize, u,
+                            k > 0 ? &ahead[!cur] : (last >= -gridSize ? &behind[0] : NULL), 1, &ahead[cur],
+                            strips ? &row : NULL, strips ? columns[1] : NULL, clip, next_horizon);
+        }
+        
+        /* The step is done, it now occludes everything behind it */
+        for (x = 0; x < vp->w; x++) horizon[x] = next_horizon[x];
+    }
+    for (v = 0; v < 2 * gridSize + 1; v++) {
+        chain_end(fog, &columns[0][v]);
+        chain_end(fog, &columns[1][v]);
     }
+    fog_flush(fog);
     
+    draw_list_color(&job->list, 255, 255, 255);
+}
+
+
+
+/* ==================== WIN SCREEN ==================== */
+// The win screen goes up in pieces: the background and text first, then each
+// portrait as the atlas loader gets to it (see main.c), so the game never stops
+// answering keys while the pictures come in
+
+#define PROF_SIZE 220 /* Professor image size - even bigger */
+#define TA_SIZE 95    // TA image size
+
+// Where every portrait goes, by name (their .ppm file names) - the professor and 14 TAs
+// The sizes above must match the -s sizes the Makefile gives packatlas
+static const struct {
+    const char *name;
+    int x, y;
+} WIN_LAYOUT[] = {
+    {"ramzinew", SCREEN_WIDTH/2 - PROF_SIZE/2, SCREEN_HEIGHT/2 - PROF_SIZE/2 + 5}, // professor in center
+    // Top row: 5 TAs
+    {"693d9e2026f2d", 25, 50}, {"693d9e7737592", 25 + (TA_SIZE + 40), 50},
+    {"asvenss2", 25 + 2 * (TA_SIZE + 40), 50}, {"cmassman", 25 + 3 * (TA_SIZE + 40), 50},
+    {"fdrake", 25 + 4 * (TA_SIZE + 40), 50},
+    // Left column: 2 TAs
+    {"hflick", 25, 160}, {"jnkouka", 25, 160 + TA_SIZE + 15},
     // Right column: 2 TAs
-    for (i = 0; i < 2; i++) {
-        int x = SCREEN_WIDTH - taSize - 25;
-        int y = 160 + i * (taSize + 15);
-        if (7 + i < numTAs) {
-            draw_ppm_scaled(ta_files[7 + i], x, y, taSize, taSize);
+    {"maiyener", SCREEN_WIDTH - TA_SIZE - 25, 160}, {"mbriamon", SCREEN_WIDTH - TA_SIZE - 25, 160 + TA_SIZE + 15},
+    /* Bottom row: 5 TAs */
+    {"mzitella", 25, SCREEN_HEIGHT - TA_SIZE - 25}, {"schou2", 25 + (TA_SIZE + 40), SCREEN_HEIGHT - TA_SIZE - 25},
+    {"sco", 25 + 2 * (TA_SIZE + 40), SCREEN_HEIGHT - TA_SIZE - 25},
+    {"sdevared", 25 + 3 * (TA_SIZE + 40), SCREEN_HEIGHT - TA_SIZE - 25},
+    {"thieber", 25 + 4 * (TA_SIZE + 40), SCREEN_HEIGHT - TA_SIZE - 25}
+};
+
+// Draw one portrait of the atlas with its top left corner at (destX, destY)
+// packatlas already resampled it to the size it is drawn at, so this is a straight copy
+void draw_portrait(const Atlas *portraits, const AtlasRect *r, int destX, int destY) {
+    const unsigned char *p;
+    int x, y;
+    
+    for (y = 0; y < r->h; y++) {
+        p = portraits->pixels + ((size_t)(r->y + y) * portraits->header->width + r->x) * 3;
+        for (x = 0; x < r->w; x++, p += 3) {
+            gfx_color(p[0], p[1], p[2]);
+            gfx_point(destX + x, destY + y);
         }
     }
+}
+
+// Draw rect number i of the atlas in its place on the win screen
+// (a picture the layout does not know about is left out)
+void draw_win_portrait(const Atlas *portraits, int i) {
+    const AtlasRect *r = &portraits->rects[i];
+    int k;
     
-    /* Bottom row: 5 TAs */
-    for (i = 0; i < 5 && 9 + i < numTAs; i++) {
-        int x = 25 + i * (taSize + 40);
-        int y = SCREEN_HEIGHT - taSize - 25;
-        draw_ppm_scaled(ta_files[9 + i], x, y, taSize, taSize);
+    for (k = 0; k < (int)(sizeof(WIN_LAYOUT) / sizeof(WIN_LAYOUT[0])); k++) {
+        if (strncmp(r->name, WIN_LAYOUT[k].name, ATLAS_NAME_LEN) == 0) {
+            draw_portrait(portraits, r, WIN_LAYOUT[k].x, WIN_LAYOUT[k].y);
+            return;
+        }
     }
+}
+
+// Everything on the win screen except the portraits
+void draw_win_background(GameState *game) {
+    int profX = SCREEN_WIDTH/2 - PROF_SIZE/2, profY = SCREEN_HEIGHT/2 - PROF_SIZE/2 + 5;
+    char time_str[64];
+    
+    // Clear to dark blue
+    gfx_clear_color(20, 20, 50);
+    gfx_clear();
+    
+    // Draw "Thank you" text at top - single line
+    gfx_color(255, 255, 0);  // Yellow text
+    gfx_text(SCREEN_WIDTH/2 - 250, 25, "Thank you Professor Ramzi and all TAs for a wonderful semester!");
+    
+    // Gold border around professor
+    gfx_color(255, 215, 0);
+    gfx_line(profX - 3, profY - 3, profX + PROF_SIZE + 3, profY - 3);
+    gfx_line(profX + PROF_SIZE + 3, profY - 3, profX + PROF_SIZE + 3, profY + PROF_SIZE + 3);
+    gfx_line(profX + PROF_SIZE + 3, profY + PROF_SIZE + 3, profX - 3, profY + PROF_SIZE + 3);
+    gfx_line(profX - 3, profY + PROF_SIZE + 3, profX - 3, profY - 3);
     
     /* Score and time at very bottom */
     gfx_color(100, 255, 100);  /* Green */
-    {
-        char time_str[64];
-        int mins = game->final_time / 60;
-        int secs = game->final_time % 60;
-        sprintf(time_str, "Won in %d:%02d! R=Restart Q=Quit", mins, secs);
-        gfx_text(SCREEN_WIDTH/2 - 100, SCREEN_HEIGHT - 8, time_str);
+    sprintf(time_str, "Won in %d:%02d! R=Restart Q=Quit", game->final_time / 60, game->final_time % 60);
+    gfx_text(SCREEN_WIDTH/2 - 100, SCREEN_HEIGHT - 8, time_str);
+}
+
+// Progress bar under the professor while the portraits load, done = 1 erases it
+void draw_win_progress(int ready, int total, int done) {
+    int x = SCREEN_CX - 100, y = SCREEN_HEIGHT/2 + PROF_SIZE/2 + 30, i, fill;
+    char msg[48];
+    
+    gfx_clip(x, y - 12, 201, 24); // only this strip, the portraits around it stay
+    gfx_clear();
+    if (!done) {
+        fill = total > 0 ? 200 * ready / total : 0;
+        gfx_color(255, 215, 0);
+        sprintf(msg, "Loading portraits %d/%d", ready, total);
+        gfx_text(x + 30, y - 2, msg);
+        gfx_line(x, y + 2, x + 200, y + 2);
+        gfx_line(x, y + 10, x + 200, y + 10);
+        for (i = 0; i <= fill; i++) gfx_line(x + i, y + 2, x + i, y + 10);
     }
+    gfx_clip(0, 0, 0, 0);
+}
+
+// Draw the whole win screen at once (the offline renderer, which has no loading to wait for)
+void draw_win_screen(GameState *game, const Atlas *portraits) {
+    int i;
+    
+    draw_win_background(game);
+    for (i = 0; portraits->header && i < (int)portraits->header->count; i++) draw_win_portrait(portraits, i);
 }
 
 
@@ -601,6 +1070,7 @@ void draw_lose_screen(GameState *game) {
     
     gfx_color(150, 150, 150);  /* Gray */
     gfx_text(SCREEN_CX - 75, SCREEN_CY + 140, "R to Restart | Q to Quit");
+    gfx_text(SCREEN_CX - 80, SCREEN_CY + 160, "B to retry from 5 seconds ago");
 }
 
 /* ==================== OBSTACLES ==================== */
@@ -610,290 +1080,234 @@ int valid_point(int x, int y) {
     return (x != -9999 && y != -9999);
 }
 
-// Helper to draw a line only if both endpoints are valid
-void safe_line(int x1, int y1, int x2, int y2) {
+// Helper to queue a line in the fog batch only if both endpoints are valid (else it is culled)
+void safe_line(FogBatch *fog, Counters *counters, int shade, int x1, int y1, int x2, int y2) {
     if (valid_point(x1, y1) && valid_point(x2, y2)) {
-        gfx_line(x1, y1, x2, y2);
+        fog_add(fog, shade, x1, y1, x2, y2);
+    } else {
+        counters->segments_culled++;
     }
 }
 
-// Draw a wireframe cube obstacle
-void draw_wireframe_cube(Point3D center, double size, double rot, Camera *cam) {
-    double half = size * 0.5;
-    double cosR = cos(rot), sinR = sin(rot);
-    Point3D corners[8];
-    int px[8], py[8];
-    int i;
-    double lx, lz, rx, rz;
-    double dx, dz, distSq, minDistSq;
-    
-    /* Skip cubes that are too close to the camera (avoid sqrt) */
-    dx = center.x - cam->position.x;
-    dz = center.z - cam->position.z;
-    distSq = dx*dx + dz*dz;
-    minDistSq = size * size * 2.25;  /* (1.5 * size)^2 */
-    if (distSq < minDistSq) {
-        return;  /* Too close, don't draw */
-    }
-    
-    /* Define and rotate 8 corners */
-    double local[8][3] = {
-        {-half, -half, -half}, {half, -half, -half},
-        {half, half, -half}, {-half, half, -half},
-        {-half, -half, half}, {half, -half, half},
-        {half, half, half}, {-half, half, half}
-    };
-    
-    // Rotate and translate corners
-    for (i = 0; i < 8; i++) {
-        lx = local[i][0];
-        lz = local[i][2];
-        rx = lx * cosR - lz * sinR;
-        rz = lx * sinR + lz * cosR;
-        corners[i].x = center.x + rx;
-        corners[i].y = center.y + local[i][1];
-        corners[i].z = center.z + rz;
-        project_point(corners[i], cam, &px[i], &py[i]);
-    }
-    
-    // Draw 12 edges (only if both endpoints are valid)
-    safe_line(px[0], py[0], px[1], py[1]);
-    safe_line(px[1], py[1], px[2], py[2]);
-    safe_line(px[2], py[2], px[3], py[3]);
-    safe_line(px[3], py[3], px[0], py[0]);
-    safe_line(px[4], py[4], px[5], py[5]);
-    safe_line(px[5], py[5], px[6], py[6]);
-    safe_line(px[6], py[6], px[7], py[7]);
-    safe_line(px[7], py[7], px[4], py[4]);
-    safe_line(px[0], py[0], px[4], py[4]);
-    safe_line(px[1], py[1], px[5], py[5]);
-    safe_line(px[2], py[2], px[6], py[6]);
-    safe_line(px[3], py[3], px[7], py[7]);
-}
+/* Unit cube template shared by every obstacle: corners at +/-0.5 and the 12 edges between them */
+static const real CUBE_TEMPLATE[8][3] = {
+    {-0.5, -0.5, -0.5}, {0.5, -0.5, -0.5},
+    {0.5, 0.5, -0.5}, {-0.5, 0.5, -0.5},
+    {-0.5, -0.5, 0.5}, {0.5, -0.5, 0.5},
+    {0.5, 0.5, 0.5}, {-0.5, 0.5, 0.5}
+};
+static const int CUBE_EDGES[12][2] = {
+    {0, 1}, {1, 2}, {2, 3}, {3, 0}, // back face
+    {4, 5}, {5, 6}, {6, 7}, {7, 4}, // front face
+    {0, 4}, {1, 5}, {2, 6}, {3, 7}  // connecting edges
+};
+/* The two faces each edge borders: 0=-X 1=+X 2=-Y 3=+Y 4=-Z 5=+Z */
+static const int CUBE_EDGE_FACES[12][2] = {
+    {2, 4}, {1, 4}, {3, 4}, {0, 4},
+    {2, 5}, {1, 5}, {3, 5}, {0, 5},
+    {0, 2}, {1, 2}, {1, 3}, {0, 3}
+};
 
-// Draw all active obstacles
-void draw_obstacles(GameState *game) {
-    int i;
+// Build the mask of cube edges that border at least one camera-facing face
+// Camera space puts the eye at the origin, so the face with outward normal s*A
+// (A = full axis, |A| = size) faces the camera when dot(s*A, center + s*A/2) < 0,
+// i.e. s*dot(A, center) < -size^2/2. Silhouette edges have one front face and stay.
+int cube_visible_edges(Point3D center, Point3D ax, Point3D ay, Point3D az, real size) {
+    real d[3], limit = (real)-0.5 * size * size;
+    int front = 0, edges = 0, e;
     
-    gfx_color(255, 100, 100);  /* Red obstacles */
-    // Draw each active obstacle
-    for (i = 0; i < MAX_OBSTACLES; i++) {
-        if (game->obstacles[i].active) {
-            draw_wireframe_cube(game->obstacles[i].position,
-                               game->obstacles[i].size,
-                               game->obstacles[i].rotation,
-                               &game->camera);
-        }
+    d[0] = ax.x * center.x + ax.y * center.y + ax.z * center.z;
+    d[1] = ay.x * center.x + ay.y * center.y + ay.z * center.z;
+    d[2] = az.x * center.x + az.y * center.y + az.z * center.z;
+    for (e = 0; e < 3; e++) {
+        if (-d[e] < limit) front |= 1 << (2 * e);      /* negative face */
+        if (d[e] < limit) front |= 1 << (2 * e + 1);   /* positive face */
     }
-    
-    gfx_color(255, 255, 255);
+    for (e = 0; e < 12; e++) {
+        if (front & ((1 << CUBE_EDGE_FACES[e][0]) | (1 << CUBE_EDGE_FACES[e][1]))) edges |= 1 << e;
+    }
+    return edges;
 }
 
-// Update obstacle positions, spawn new ones
-void update_obstacles(GameState *game) {
-    int i, active_count = 0;
-    double dist, angle;
-    double dx, dz, distSqFromCam;
-    double maxDistSq = 1500.0 * 1500.0;  /* Precompute threshold */
-    Obstacle *obs;
-    
-    // Update existing obstacles
-    for (i = 0; i < MAX_OBSTACLES; i++) {
-        obs = &game->obstacles[i]; // get pointer to obstacle
-        if (obs->active) { // if active
-            active_count++; // count active obstacles
-            obs->rotation += 0.02; // rotate obstacle
+// Draw a batch of wireframe cubes as instances of the unit cube template
+// Only the count obstacles listed in live are looked at (the chunks' live list),
+// so the empty slots are never walked.
+// Each obstacle only supplies position, size and rotation. Its three axes are
+// scaled, rotated and moved into camera space once, then every corner is just
+// center + template * axes, so there is no per-corner trig or project_point call.
+// With hidden_lines set, each cube only draws edges of its camera-facing faces.
+// Cubes further than max_dist (horizontally) are not drawn.
+// Projected corners (and those behind the camera) are added to counters.
+// Edges go into the fog batch, shaded by the cube's distance.
+void draw_cube_instances(const Obstacle *obs, const short *live, int count, const Viewport *vp, int hidden_lines, double max_dist, Counters *counters,
+                         FogBatch *fog) {
+    const Camera *cam = &vp->camera;
+    Point3D center[CUBE_BATCH], axisX[CUBE_BATCH], axisY[CUBE_BATCH], axisZ[CUBE_BATCH];
+    int px[CUBE_BATCH][8], py[CUBE_BATCH][8], edges[CUBE_BATCH], shade[CUBE_BATCH];
+    const Obstacle *o;
+    int n, i, k, e, a, b;
+    real cosR, sinR, dx, dz, size;
+    Point3D c;
+    
+    for (i = 0; i < count; ) {
+        /* Pass 1: gather visible instances and build their camera-space axes */
+        for (n = 0; n < CUBE_BATCH && i < count; i++) {
+            o = &obs[live[i]];
+            if (!o->active) continue; // shot since its chunk loaded
+            
+            /* Skip cubes that are too close to the camera (avoid sqrt) */
+            size = o->size;
+            dx = o->position.x - cam->position.x;
+            dz = o->position.z - cam->position.z;
+            if (dx*dx + dz*dz < size * size * 2.25) continue;  /* (1.5 * size)^2 */
+            if (dx*dx + dz*dz > max_dist * max_dist) continue;
             
-            // Remove if too far from camera (any direction) - avoid sqrt
-            dx = obs->position.x - game->camera.position.x;
-            dz = obs->position.z - game->camera.position.z;
-            distSqFromCam = dx*dx + dz*dz;
-            if (distSqFromCam > maxDistSq) {
-                obs->active = 0;
-                active_count--;
+            cosR = cos(o->rotation);
+            sinR = sin(o->rotation);
+            camera_rotate(cam, dx, o->position.y - cam->position.y, dz, &center[n]);
+            camera_rotate(cam, size * cosR, 0.0, size * sinR, &axisX[n]);   // rotated local X
+            camera_rotate(cam, 0.0, size, 0.0, &axisY[n]);                  // local Y (rotation is about Y)
+            camera_rotate(cam, -size * sinR, 0.0, size * cosR, &axisZ[n]);  // rotated local Z
+            edges[n] = hidden_lines ? cube_visible_edges(center[n], axisX[n], axisY[n], axisZ[n], size) : 0xFFF;
+            shade[n] = fog->levels > 1 ? fog_bucket(fog, sqrt(dx*dx + dz*dz), max_dist) : 0;
+            n++;
+        }
+        
+        /* Pass 2: transform and project every corner of the batch */
+        for (k = 0; k < n; k++) {
+            for (e = 0; e < 8; e++) {
+                c.x = center[k].x + CUBE_TEMPLATE[e][0] * axisX[k].x + CUBE_TEMPLATE[e][1] * axisY[k].x + CUBE_TEMPLATE[e][2] * axisZ[k].x;
+                c.y = center[k].y + CUBE_TEMPLATE[e][0] * axisX[k].y + CUBE_TEMPLATE[e][1] * axisY[k].y + CUBE_TEMPLATE[e][2] * axisZ[k].y;
+                c.z = center[k].z + CUBE_TEMPLATE[e][0] * axisX[k].z + CUBE_TEMPLATE[e][1] * axisY[k].z + CUBE_TEMPLATE[e][2] * axisZ[k].z;
+                project_camera_space(vp, c, &px[k][e], &py[k][e]);
+                if (px[k][e] == -9999) counters->vertices_behind++;
             }
         }
-    }
-    
-    // Spawn new obstacles (but not after the game is over)
-    if (!game->show_Win_Screen && active_count < 8 && rand() % 40 == 0) {
-        for (i = 0; i < MAX_OBSTACLES; i++) {
-            if (!game->obstacles[i].active) { // find inactive obstacle
-                obs = &game->obstacles[i]; // get pointer to it
-                obs->active = 1; // activate it
-                
-                // Scatter around field of vision - random angle within ~120 degree FOV
-                dist = 400 + rand() % 600; // Distance from camera
-                angle = game->camera.yaw + ((rand() % 120) - 60) * PI / 180.0;  // -60 to +60 degrees 
-                
-                obs->position.x = game->camera.position.x + dist * sin(angle);
-                obs->position.z = game->camera.position.z + dist * cos(angle);
-                obs->position.y = get_terrain_height(game, obs->position.x, obs->position.z) 
-                                  + 30 + rand() % 100;  // More height variation 
-                obs->size = 30 + rand() % 30;
-                obs->rotation = 0;
-                break;
+        counters->vertices_projected += 8 * n;
+        
+        /* Pass 3: draw the cube's edges (only if both endpoints are valid) */
+        for (k = 0; k < n; k++) {
+            for (e = 0; e < 12; e++) {
+                if (!(edges[k] & (1 << e))) continue;
+                a = CUBE_EDGES[e][0];
+                b = CUBE_EDGES[e][1];
+                safe_line(fog, counters, shade[k], px[k][a], py[k][a], px[k][b], py[k][b]);
             }
         }
     }
 }
 
+// Draw all active obstacles
+void draw_obstacles(const GameState *game, ViewJob *job) {
+    fog_begin(&job->fog, &job->list, game->fog ? FOG_BUCKETS : 1, 255, 100, 100);  /* Red obstacles */
+    draw_cube_instances(game->obstacles, game->chunks.live, game->chunks.live_count, &job->vp, game->hidden_lines, game->quality.obstacle_distance,
+                        &job->counters, &job->fog);
+    fog_flush(&job->fog);
+    draw_list_color(&job->list, 255, 255, 255);
+}
+
 
 
 /* ==================== BULLETS ==================== */
 
-// Draw all active bullets
-void draw_bullets(GameState *game) {
-    int i, sx, sy;
+// Draw all active bullets, shaded by distance like the cubes
+void draw_bullets(const GameState *game, ViewJob *job) {
+    const Viewport *vp = &job->vp;
+    FogBatch *fog = &job->fog;
+    int i, sx, sy, shade;
+    real dx, dy, dz;
     
-    gfx_color(255, 255, 0);  /* Yellow bullets */
+    fog_begin(fog, &job->list, game->fog ? FOG_BUCKETS : 1, 255, 255, 0);  /* Yellow bullets */
     
     for (i = 0; i < MAX_BULLETS; i++) {
         if (game->bullets[i].active) {
-            project_point(game->bullets[i].position, &game->camera, &sx, &sy);
-            if (sx > 0 && sx < SCREEN_WIDTH && sy > 0 && sy < SCREEN_HEIGHT) {
-                gfx_line(sx - 3, sy, sx + 3, sy); //this just draws a cross for the bullet
-                gfx_line(sx, sy - 3, sx, sy + 3);
+            project_point(game->bullets[i].position, vp, &sx, &sy);
+            job->counters.vertices_projected++;
+            if (sx == -9999) job->counters.vertices_behind++;
+            if (sx > vp->x && sx < vp->x + vp->w && sy > vp->y && sy < vp->y + vp->h) {
+                shade = 0;
+                if (fog->levels > 1) {
+                    dx = game->bullets[i].position.x - vp->camera.position.x;
+                    dy = game->bullets[i].position.y - vp->camera.position.y;
+                    dz = game->bullets[i].position.z - vp->camera.position.z;
+                    shade = fog_bucket(fog, sqrt(dx*dx + dy*dy + dz*dz), game->quality.obstacle_distance);
+                }
+                fog_add(fog, shade, sx - 3, sy, sx + 3, sy); //this just draws a cross for the bullet
+                fog_add(fog, shade, sx, sy - 3, sx, sy + 3);
+            } else {
+                job->counters.segments_culled += 2; // the cross is off screen or behind
             }
         }
     }
+    fog_flush(fog);
     
-    gfx_color(255, 255, 255);
+    draw_list_color(&job->list, 255, 255, 255);
 }
 
-// Fire a new bullet from camera position
-void fire_bullet(GameState *game) {
-    int i;
-    Bullet *b;
-    Camera *cam = &game->camera;
 
-    // Find inactive bullet slot
-    for (i = 0; i < MAX_BULLETS; i++) {
-        if (!game->bullets[i].active) {
-            b = &game->bullets[i];
-            b->active = 1;
-            b->position = cam->position;
-            // Use cached trig values 
-            b->velocity.x = BULLET_SPEED * cam->sin_yaw * cam->cos_pitch; // set x velocity
-            b->velocity.y = BULLET_SPEED * cam->sin_pitch; // set y velocity
-            b->velocity.z = BULLET_SPEED * cam->cos_yaw * cam->cos_pitch; // set z velocity
-            return;
-        }
-    }
-}
-
-// Update bullet positions and deactivate if out of range
-void update_bullets(GameState *game) {
-    int i;
-    double dx, dy, dz, distSq;
-    Bullet *b;
-    // Update each active bullet
-    for (i = 0; i < MAX_BULLETS; i++) {
-        b = &game->bullets[i];
-        if (b->active) {
-            b->position.x += b->velocity.x;
-            b->position.y += b->velocity.y;
-            b->position.z += b->velocity.z;
-            
-            /* Check distance from camera */
-            dx = b->position.x - game->camera.position.x;
-            dy = b->position.y - game->camera.position.y;
-            dz = b->position.z - game->camera.position.z;
-            distSq = dx*dx + dy*dy + dz*dz;
-            
-            if (distSq > RENDER_DISTANCE * RENDER_DISTANCE * 2) {
-                b->active = 0;
-            }
-            
-            /* Check if hit ground */
-            if (b->position.y < get_terrain_height(game, b->position.x, b->position.z)) {
-                b->active = 0;
-            }
-        }
-    }
-}
 
+/* ==================== DEBRIS ==================== */
 
-
-// Check for collisions between bullets, obstacles, and player
-void check_collisions(GameState *game) {
-    int i, j;
-    double dx, dy, dz, distSq, hitDist;
+// Draw every debris piece as a short streak back along its velocity
+// Streaks are projected into a batch first and the whole batch goes out in one
+// gfx_segments call, with a single color change for all the debris.
+void draw_particles(const GameState *game, ViewJob *job) {
+    const ParticlePool *p = &game->particles;
+    const Viewport *vp = &job->vp;
+    const Camera *cam = &vp->camera;
+    int xy[DEBRIS_BATCH * 4];
+    int i, n = 0, x1, y1, x2, y2;
+    Point3D c;
     
-    // Check bullet-obstacle collisions
-    for (i = 0; i < MAX_BULLETS; i++) {
-        if (!game->bullets[i].active) continue;
-        
-        // Check against all obstacles
-        for (j = 0; j < MAX_OBSTACLES; j++) {
-            if (!game->obstacles[j].active) continue;
-            
-            // Calculate squared distance
-            dx = game->bullets[i].position.x - game->obstacles[j].position.x;
-            dy = game->bullets[i].position.y - game->obstacles[j].position.y;
-            dz = game->bullets[i].position.z - game->obstacles[j].position.z;
-            distSq = dx*dx + dy*dy + dz*dz;
-            
-            hitDist = game->obstacles[j].size; // hit distance based on obstacle size
-            
-            if (distSq < hitDist * hitDist) {
-                game->bullets[i].active = 0;
-                game->obstacles[j].active = 0;
-                game->score += 100;
-                printf("\a");  /* Beep jingle for hit! */
-                fflush(stdout);
-                printf("HIT! Score: %d\n", game->score);
-                
-                if (game->score >= WIN_SCORE && !game->show_Win_Screen) {
-                    printf("\n*** SCORE %d REACHED! Professor terrain unlocked! ***\n\n", WIN_SCORE);
-                }
-            }
-        }
-    }
+    if (p->count == 0) return;
+    draw_list_color(&job->list, 255, 160, 60);  /* Orange debris */
     
-    //Check player-obstacle collisions (lose a life)
-    for (j = 0; j < MAX_OBSTACLES; j++) {
-        if (!game->obstacles[j].active) continue;
-        
-        dx = game->camera.position.x - game->obstacles[j].position.x;
-        dy = game->camera.position.y - game->obstacles[j].position.y;
-        dz = game->camera.position.z - game->obstacles[j].position.z;
-        distSq = dx*dx + dy*dy + dz*dz;
-        
-        hitDist = game->obstacles[j].size + 20;  /* Player collision radius */
-        
-        if (distSq < hitDist * hitDist) {
-            game->obstacles[j].active = 0;  /* Destroy the obstacle */
-            game->lives--;
-            printf("\a");  /* Crash sound */
-            printf("COLLISION! Lives remaining: %d\n", game->lives);
-            
-            if (game->lives <= 0) {
-                game->game_over = 1;
-                printf("\n*** OUT OF LIVES! ***\n");
-            }
+    for (i = 0; i < p->count; i++) {
+        camera_rotate(cam, p->x[i] - cam->position.x, p->y[i] - cam->position.y, p->z[i] - cam->position.z, &c);
+        project_camera_space(vp, c, &x1, &y1);
+        camera_rotate(cam, p->x[i] - 2.0f * p->vx[i] - cam->position.x, p->y[i] - 2.0f * p->vy[i] - cam->position.y,
+                      p->z[i] - 2.0f * p->vz[i] - cam->position.z, &c);
+        project_camera_space(vp, c, &x2, &y2);
+        // Counted per end like the terrain and cubes, the streak is culled if either is behind
+        job->counters.vertices_behind += (x1 == -9999) + (x2 == -9999);
+        if (x1 == -9999 || x2 == -9999) {
+            job->counters.segments_culled++;
+            continue;
+        }
+        xy[n * 4] = x1;
+        xy[n * 4 + 1] = y1;
+        xy[n * 4 + 2] = x2;
+        xy[n * 4 + 3] = y2;
+        if (++n == DEBRIS_BATCH) {
+            draw_list_segments(&job->list, xy, n);
+            n = 0;
         }
     }
+    draw_list_segments(&job->list, xy, n);
+    job->counters.vertices_projected += 2 * p->count;
+    
+    draw_list_color(&job->list, 255, 255, 255);
 }
 
 
 
 /* ==================== HUD ==================== */
 
-// Draw crosshair at center of screen
-void draw_crosshair(void) {
+// Draw crosshair at the center of the player's view
+void draw_crosshair(const Viewport *vp) {
     gfx_color(255, 255, 0);  /* Yellow for visibility */
-    gfx_line(SCREEN_CX - 15, SCREEN_CY, SCREEN_CX - 5, SCREEN_CY);
-    gfx_line(SCREEN_CX + 5, SCREEN_CY, SCREEN_CX + 15, SCREEN_CY);
-    gfx_line(SCREEN_CX, SCREEN_CY - 15, SCREEN_CX, SCREEN_CY - 5);
-    gfx_line(SCREEN_CX, SCREEN_CY + 5, SCREEN_CX, SCREEN_CY + 15);
+    gfx_line(vp->cx - 15, vp->cy, vp->cx - 5, vp->cy);
+    gfx_line(vp->cx + 5, vp->cy, vp->cx + 15, vp->cy);
+    gfx_line(vp->cx, vp->cy - 15, vp->cx, vp->cy - 5);
+    gfx_line(vp->cx, vp->cy + 5, vp->cx, vp->cy + 15);
     gfx_color(255, 255, 255);
 }
 
 // Draw heads-up display (HUD)
+// The strings are only sprintf'd when their number changes, see HudText
 void draw_hud(GameState *game) {
-    int i, bar_len, x;
-    char score_str[32];
+    HudText *hud = &game->hud;
+    int i, bar_len, x, elapsed;
     
     gfx_color(0, 255, 0);
     
@@ -905,21 +1319,23 @@ void draw_hud(GameState *game) {
     gfx_line(10, 12, 10 + bar_len, 12);
     
     /* Score text next to bar */
-    sprintf(score_str, "%d/%d", game->score, WIN_SCORE);
-    gfx_text(220, 12, score_str);
+    if (hud->score != game->score) {
+        hud->score = game->score;
+        sprintf(hud->score_str, "%d/%d", game->score, WIN_SCORE);
+    }
+    gfx_text(220, 12, hud->score_str);
     
     /* Timer display */
-    {
-        char time_str[32];
-        int elapsed;
-        if (game->show_Win_Screen) {
-            elapsed = game->final_time;
-        } else {
-            elapsed = (int)(time(NULL) - game->start_time);
-        }
-        sprintf(time_str, "Time: %d:%02d", elapsed / 60, elapsed % 60);
-        gfx_text(10, 25, time_str);
+    if (game->show_Win_Screen) {
+        elapsed = game->final_time;
+    } else {
+        elapsed = (int)(time(NULL) - game->start_time);
+    }
+    if (hud->seconds != elapsed) {
+        hud->seconds = elapsed;
+        sprintf(hud->time_str, "Time: %d:%02d", elapsed / 60, elapsed % 60);
     }
+    gfx_text(10, 25, hud->time_str);
     
     /* Win indicator */
     if (game->score >= WIN_SCORE) {
@@ -937,5 +1353,13 @@ void draw_hud(GameState *game) {
         gfx_circle(x, 15, 5);
     }
     
+    /* Quality level picked by the governor */
+    if (hud->level != game->governor.level) {
+        hud->level = game->governor.level;
+        sprintf(hud->quality_str, "Detail: %d/%d", game->governor.level, QUALITY_LEVELS - 1);
+    }
+    gfx_color(150, 150, 150);
+    gfx_text(SCREEN_WIDTH - 100, 35, hud->quality_str);
+    
     gfx_color(255, 255, 255);
 }
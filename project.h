@@ -0,0 +1,403 @@
+/*
+ * 3D Flight Shooter - shared constants, data structures and function declarations
+ * Author: Matus Vecera
+ *
+ * The simulation lives in sim.c (no drawing, no printing) and the drawing in
+ * project.c. The interactive X11 game (main.c) and the offline video renderer
+ * (render.c) use both, the headless batch runner (batch.c) only needs sim.c.
+ */
+
+#ifndef PROJECT_H
+#define PROJECT_H
+
+#include <stdio.h> // for FILE
+#include <time.h> // for time_t
+#include <stddef.h> // for offsetof
+#include <pthread.h> // for the view workers
+#include "particles.h"
+#include "atlas.h"
+
+/* ==================== CONSTANTS  ==================== */
+#define SCREEN_WIDTH 800
+#define SCREEN_HEIGHT 600
+#define SCREEN_CX 400
+#define SCREEN_CY 300
+#define GRID_SIZE 20 // default detail, the quality governor changes these at runtime
+#define GRID_SPACING 25
+#define RENDER_DISTANCE 1200
+#define OBSTACLE_DISTANCE 1500
+#define GRID_SIZE_MAX 32 // largest grid radius any quality level uses
+#define TERRAIN_SIDE_MAX (2 * GRID_SIZE_MAX + 1) // terrain vertices along one side of the grid
+#define QUALITY_LEVELS 6
+#define QUALITY_DEFAULT 3 // the level matching the constants above
+#define GOVERNOR_WINDOW 30 // frames averaged before the governor decides
+#define CHUNK_SIZE 400 // the world is cut into CHUNK_SIZE x CHUNK_SIZE squares, each places its own cubes
+// Chunks kept loaded on each side of the camera's chunk: enough that everything within
+// OBSTACLE_DISTANCE (the furthest any quality level draws cubes) is always loaded
+#define CHUNK_RADIUS ((OBSTACLE_DISTANCE + CHUNK_SIZE - 1) / CHUNK_SIZE)
+#define CHUNK_SIDE (2 * CHUNK_RADIUS + 1)
+#define CHUNK_SLOTS (CHUNK_SIDE * CHUNK_SIDE) // loaded chunks, a 9x9 square around the camera
+#define CHUNK_CUBES_MAX 8 // most cubes one chunk can hold
+#define MAX_OBSTACLES (CHUNK_SLOTS * CHUNK_CUBES_MAX)
+#define MAX_KILLS 64 // destroyed cubes remembered, so flying back does not bring them back
+#define START_CLEAR 400.0 // no cubes this close to where the game starts
+#define MAX_BULLETS 10
+#define BULLET_SPEED 15.0
+#define WIN_SCORE 1000
+#define PI 3.14159265358979 //I made this becuase PI constant in math libary was being weird
+#define FOV_SCALE ((real)0.8) // Field of view scaling factor
+#define PROJ_DISTANCE ((real)300.0) // Distance from camera to projection plane
+#define START_SPEED 1.5
+#define CUBE_BATCH 64 // obstacles transformed together per instanced pass
+#define STEER_SPEED 0.06 // How fast camera turns toward mouse
+#define REBASE_DISTANCE 4096.0 // move the world origin to the camera once it flies this far from it
+#define COUNTERS 10 // fields in Counters
+#define HIT_DEBRIS 240 // particles in the burst when a bullet hits a cube
+#define CRASH_DEBRIS 120 // ...and when the player flies into one
+#define DEBRIS_BATCH 512 // debris lines projected before they are sent to gfx together
+#define MAX_VIEWPORTS 2 // views drawn in one frame (main + rear view)
+#define VIEW_MODES 3 // V cycles: one view, rear-view mirror, split screen
+#define FOG_BUCKETS 12 // depth cue shades, each one is a single color change
+#define FOG_BATCH 512 // segments a shade holds before it has to be drawn
+#define FOG_STRIP_POINTS 1024 // polyline points a shade holds (terrain strips)...
+#define FOG_STRIPS 256 // ...in at most this many strips
+#define DRAW_COLOR 0 // DrawList calls: r, g, b
+#define DRAW_LINE 1 // x1, y1, x2, y2
+#define DRAW_CIRCLE 2 // x, y, r
+#define DRAW_SEGMENTS 3 // n, then x1, y1, x2, y2 n times
+#define DRAW_POLYLINE 4 // n, then x, y n times
+#define SIM_PLAYING 0 // simulate_frame results
+#define SIM_LOST 1
+#define SIM_WON 2
+#define SNAPSHOT_EVERY 8 // frames between rewind snapshots (10 a second at ~80 FPS)
+#define SNAPSHOTS 64 // snapshots kept, 6.4 seconds of history
+#define REWIND_STEPS 10 // snapshots one press of B goes back (1 second)
+#define RETRY_STEPS 50 // ...and "retry from 5 seconds ago" on the lose screen
+
+/* ==================== DATA STRUCTURES ==================== */
+// Number type for positions, velocities and the projection math
+// make FLOAT=1 builds it as float32, the origin is rebased so positions stay small
+#ifdef USE_FLOAT
+typedef float real;
+#else
+typedef double real;
+#endif
+
+// 3D point structure
+typedef struct {
+    real x, y, z;
+} Point3D;
+
+// Camera structure
+typedef struct {
+    Point3D position;
+    real pitch, yaw; // rotation angles
+    real cos_pitch, sin_pitch, cos_yaw, sin_yaw;  /* precomputed trig */
+    real speed; // movement speed
+} Camera;
+
+// Bullet structure
+typedef struct {
+    Point3D position; //bullet position
+    Point3D velocity; //bullet velocity
+    int active; //1=active, 0=inactive
+} Bullet;
+
+// Obstacle structure
+typedef struct {
+    Point3D position;              
+    real size;
+    real rotation;
+    int active;      
+} Obstacle;
+
+// Detail settings for one quality level
+typedef struct {
+    int grid_size;            // terrain grid radius in cells
+    double grid_spacing;      // terrain cell size
+    double render_distance;   // terrain draw distance
+    double obstacle_distance; // cube draw distance
+} Quality;
+
+// Adaptive quality governor: rolling frame time window and current level
+typedef struct {
+    double target_ms;                  // frame time to hold, 0 = governor off
+    double samples[GOVERNOR_WINDOW];   // recent frame times in ms
+    double sum;                        // sum of samples
+    int count, next;                   // samples filled, next slot to overwrite
+    int level;                         // current quality level
+    double average_ms;                 // average of the last full window
+} Governor;
+
+// Difficulty knobs (the batch runner changes these to tune the game)
+typedef struct {
+    int chunk_cubes;      // each chunk holds 0 to chunk_cubes obstacles (at most CHUNK_CUBES_MAX)
+    real hit_scale;       // bullet hit radius = obstacle size * hit_scale
+    real player_radius;   // added to obstacle size for flying into it
+    real start_speed;     // camera speed at the start of a game
+    double rebase_distance; // move the origin once the camera is this far from it (0 = never, batch -L)
+} Tuning;
+
+// What happened during the last simulated frame, the front end reports it
+typedef struct {
+    int hits;        // obstacles shot
+    int collisions;  // obstacles flown into (one life each)
+    int crashed;     // 1 = hit the ground
+} FrameEvents;
+
+// How much work one frame did, for profiling (zeroed by simulate_frame)
+typedef struct {
+    int vertices_projected;  // points run through the perspective projection
+    int vertices_behind;     // ...of those, rejected as behind the camera
+    int segments;            // gfx_line calls
+    int segments_offscreen;  // ...of those, entirely off one side of the screen
+    int segments_culled;     // lines the game dropped before gfx (an end behind the camera or far off screen)
+    int color_changes;       // gfx_color calls
+    int terrain_heights;     // get_terrain_height calls
+    int collision_tests;     // bullet-obstacle and player-obstacle pairs checked
+    int chunks_loaded;       // world chunks that placed their cubes
+    int vertices_submitted;  // line endpoints sent to gfx, 2 per segment and 1 per polyline point
+} Counters;
+
+// HUD strings, formatted again only when the number in them changes
+// (the gfx layer caches their layouts too, so a frame where nothing changed just blits them)
+typedef struct {
+    int score, seconds, level;  // what the strings say now, -1 = not made yet
+    char score_str[32], time_str[32], quality_str[32];
+} HudText;
+
+// A destroyed cube: cube k of chunk (cx, cz)
+typedef struct {
+    int cx, cz, k;
+} CubeKill;
+
+// Which world chunk every slot holds, chunk (cx, cz) always goes into the same slot
+// and its cubes are obstacles[slot * CHUNK_CUBES_MAX ...]
+typedef struct {
+    int cx[CHUNK_SLOTS], cz[CHUNK_SLOTS];
+    unsigned char loaded[CHUNK_SLOTS];
+    int centre_x, centre_z; // the camera's chunk when the slots were last filled
+    int ready;              // 0 = fill every slot on the next update
+    short live[MAX_OBSTACLES]; // obstacles placed when the chunks were loaded, so loops skip the empty slots
+    int live_count;
+} ChunkTable;
+
+//camera and game state
+// Everything the game needs to continue from a moment comes first, snapshots copy
+// that part as one block (SNAPSHOT_SIZE bytes, up to hidden_lines), so it must stay
+// plain values with no pointers. Settings, the loaded cubes (rebuilt from the seed),
+// per-frame output and debris come after.
+typedef struct {
+    Camera camera;
+    Bullet bullets[MAX_BULLETS];
+    unsigned int world_seed; /* where the cubes are, every chunk hashes this with its coordinates */
+    int tick;            /* frames simulated this game (sets the spin of newly loaded cubes) */
+    CubeKill kills[MAX_KILLS]; /* the last MAX_KILLS cubes destroyed */
+    int kill_count, kill_next;
+    int score;
+    int lives;
+    int is_moving;
+    double origin_x, origin_z; /* world position of the local origin, always double */
+    real phase_x, phase_z, phase_xz; /* terrain sine phases at the origin, kept within 2*PI */
+    unsigned int rng;    /* this game's random number state (game_rand) */
+    int show_Win_Screen;  /* unlocked when score >= WIN_SCORE */
+    int game_over;       /* 1 = crashed/died */
+    time_t start_time;   /* when game started */  
+    int final_time;      /* seconds to win (frozen at win) */                  
+    
+    int hidden_lines;    /* 1 = cubes draw only edges of camera-facing faces */
+    int terrain_occlusion; /* 1 = terrain hidden behind nearer ridges is not drawn */
+    int view_mode;       /* 0 = one view, 1 = + rear-view mirror, 2 = split screen front/back */
+    int fog;             /* 1 = far lines fade out (depth cueing) */
+    int terrain_strips;  /* 1 = terrain goes out as row/column polylines, 0 = one segment per edge */
+    Obstacle obstacles[MAX_OBSTACLES]; /* cubes of the loaded chunks, rebuilt from world_seed after a rewind */
+    ChunkTable chunks;   /* which chunk each block of obstacles belongs to */
+    Quality quality;     /* current detail settings */
+    Governor governor;   /* picks the quality level from frame times */
+    Tuning tuning;       /* difficulty, survives restarts */
+    FrameEvents events;  /* filled by simulate_frame */
+    Counters counters;   /* work done this frame */
+    HudText hud;         /* last HUD strings drawn */
+    ParticlePool particles; /* debris from hits and collisions (not in snapshots, it is just looks) */
+} GameState;
+
+#define SNAPSHOT_SIZE offsetof(GameState, hidden_lines) // bytes of GameState a snapshot saves
+
+// Ring of recent snapshots for rewinding, fixed size so it never allocates
+// Its size does not depend on MAX_PARTICLES because the debris is left out
+typedef struct {
+    unsigned char state[SNAPSHOTS][SNAPSHOT_SIZE]; // saved start of GameState, oldest first from next - count
+    int count, next;     // snapshots held, slot the next one goes into
+    int since;           // frames since the last snapshot
+    int taken;           // snapshots taken so far (for the cost report)
+    double seconds;      // time spent taking them
+} SnapshotRing;
+
+// One view of the world drawn into a rectangle of the window
+typedef struct {
+    int x, y, w, h;      // screen rectangle
+    int cx, cy;          // where straight ahead lands on screen
+    real fov;            // projection scale, FOV_SCALE for the main view (smaller = narrower view)
+    int mirror;          // 1 = flipped left/right like a real mirror
+    int sun;             // 1 = draw the sun (views looking forward)
+    Camera camera;       // where it looks from, the rear view is the player camera turned around
+} Viewport;
+
+// Terrain heights for one frame, evaluated once and shared by every viewport
+// Vertex (i, j) is at world (x[i], height[j * side + i], z[j]), i and j from 0 to 2 * grid_size
+typedef struct {
+    int grid_size;
+    real x[TERRAIN_SIDE_MAX], z[TERRAIN_SIDE_MAX];
+    real height[TERRAIN_SIDE_MAX * TERRAIN_SIDE_MAX];
+    unsigned char near[TERRAIN_SIDE_MAX * TERRAIN_SIDE_MAX]; // within the render distance
+    unsigned char shade[TERRAIN_SIDE_MAX * TERRAIN_SIDE_MAX]; // fog bucket from the distance to the camera
+} TerrainSet;
+
+// gfx calls for one view, recorded on whichever thread culls it and played back
+// on the main thread (gfx is not thread safe)
+typedef struct {
+    int *data;           // each call's DRAW_ code and then its arguments
+    int n, size;         // ints used and allocated, kept from frame to frame
+} DrawList;
+
+// Line segments sorted by depth into fog shades, every shade goes out with one
+// color change and one gfx_segments call (or a few, if it fills up)
+// plus one gfx_polyline per strip
+typedef struct {
+    DrawList *out;                        // where the shades go
+    int levels;                           // shades in use, 1 = fog off (all full color)
+    int r, g, b;                          // full color of what is being drawn
+    int n[FOG_BUCKETS];                   // segments waiting in each shade
+    int xy[FOG_BUCKETS][FOG_BATCH * 4];   // x1,y1,x2,y2 for each of them
+    int strips[FOG_BUCKETS];              // strips waiting in each shade
+    int points[FOG_BUCKETS];              // ...and their points all together
+    int strip_len[FOG_BUCKETS][FOG_STRIPS]; // points in each strip
+    int strip_xy[FOG_BUCKETS][FOG_STRIP_POINTS * 2]; // x,y of every point, strip after strip
+} FogBatch;
+
+// A terrain polyline being built along one grid row or column
+// It grows while each new edge starts where the last one ended in the same shade
+typedef struct {
+    int shade;
+    int n;               // points so far
+    int xy[(TERRAIN_SIDE_MAX + 1) * 2];
+} TerrainChain;
+
+// One row of terrain vertices in one viewport, as draw_terrain walks them
+typedef struct {
+    int x[TERRAIN_SIDE_MAX], y[TERRAIN_SIDE_MAX]; // screen position
+    int near[TERRAIN_SIDE_MAX], shade[TERRAIN_SIDE_MAX];
+} TerrainRow;
+
+// The terrain vertices projected into one viewport
+typedef struct {
+    int sx[TERRAIN_SIDE_MAX * TERRAIN_SIDE_MAX], sy[TERRAIN_SIDE_MAX * TERRAIN_SIDE_MAX];
+    int behind;          // vertices behind its camera
+} TerrainView;
+
+// One view's share of a frame: what it is culled with and what comes out
+typedef struct {
+    Viewport vp;
+    TerrainView view;
+    FogBatch fog;
+    DrawList list;       // its gfx calls, played back on the main thread
+    Counters counters;   // its work, added to the frame's when it is played back
+} ViewJob;
+
+// Threads that stay up for the whole game and cull the extra views (the main view
+// is culled on the main thread at the same time)
+typedef struct {
+    ViewJob jobs[MAX_VIEWPORTS];
+    const GameState *game;   // this frame, set before the workers are woken
+    const TerrainSet *set;
+    int views;           // views this frame
+    int next;            // next view nobody has started on
+    int pending;         // views after the first one not finished yet
+    int frame;           // goes up by one for every frame handed out
+    int quit;
+    int threads;         // workers running, 0 = the main thread culls every view
+    pthread_t thread[MAX_VIEWPORTS - 1];
+    pthread_mutex_t lock; // guards game to quit
+    pthread_cond_t cond;
+} ViewWorkers;
+
+/* ==================== FUNCTION DECLARATIONS ==================== */
+
+void init_game(GameState *game);
+void set_origin(GameState *game, double x, double z);
+void default_tuning(GameState *game);
+void seed_game(GameState *game, unsigned int seed);
+int game_rand(GameState *game);
+int simulate_frame(GameState *game, int mouse_x, int mouse_y);
+void report_events(GameState *game);
+void init_settings(GameState *game, double target_ms);
+void set_quality(GameState *game, int level);
+void governor_frame(GameState *game, double frame_ms);
+double now_seconds(void);
+const char *counter_name(int i);
+int counter_value(const Counters *c, int i);
+void counters_add(Counters *to, const Counters *from);
+int counter_lookup(const char *name);
+void counters_csv_header(FILE *f);
+void counters_csv_row(FILE *f, int frame, double frame_ms, const Counters *c);
+int steer_center_y(const GameState *game);
+void update_camera(GameState *game, int mouse_x, int mouse_y);
+void rebase_origin(GameState *game);
+void check_ground(GameState *game);
+int handle_key(GameState *game, char c);
+void cull_view(const GameState *game, const TerrainSet *set, ViewJob *job);
+void view_workers_start(ViewWorkers *w);
+void view_workers_stop(ViewWorkers *w);
+void view_workers_run(ViewWorkers *w, const GameState *game, const TerrainSet *set, const Viewport *vp, int n);
+void draw_frame(GameState *game, ViewWorkers *workers);
+void draw_list_color(DrawList *list, int r, int g, int b);
+void draw_list_line(DrawList *list, int x1, int y1, int x2, int y2);
+void draw_list_circle(DrawList *list, int x, int y, int r);
+void draw_list_segments(DrawList *list, const int *xy, int n);
+void draw_list_polyline(DrawList *list, const int *xy, int n);
+void draw_list_play(const DrawList *list);
+void update_camera_trig(Camera *cam);
+void camera_rotate(const Camera *cam, real x, real y, real z, Point3D *out);
+int setup_viewports(GameState *game, Viewport *vp);
+void project_camera_space(const Viewport *vp, Point3D c, int *sx, int *sy);
+void project_point(Point3D p, const Viewport *vp, int *sx, int *sy);
+real get_terrain_height(GameState *game, real x, real z);
+void draw_sky(const Viewport *vp, DrawList *out);
+void build_terrain(GameState *game, TerrainSet *set);
+void project_terrain(const TerrainSet *set, const Viewport *vp, TerrainView *view);
+void draw_terrain(const GameState *game, const TerrainSet *set, ViewJob *job);
+void fog_begin(FogBatch *fog, DrawList *out, int levels, int r, int g, int b);
+int fog_shade(int levels, double dist, double max_dist);
+int fog_bucket(const FogBatch *fog, double dist, double max_dist);
+void fog_add(FogBatch *fog, int shade, int x1, int y1, int x2, int y2);
+void fog_strip(FogBatch *fog, int shade, const int *xy, int n);
+void fog_flush(FogBatch *fog);
+void draw_portrait(const Atlas *portraits, const AtlasRect *r, int destX, int destY);
+void draw_win_background(GameState *game);
+void draw_win_portrait(const Atlas *portraits, int i);
+void draw_win_progress(int ready, int total, int done);
+void draw_win_screen(GameState *game, const Atlas *portraits);
+void draw_lose_screen(GameState *game);
+void draw_obstacles(const GameState *game, ViewJob *job);
+void draw_cube_instances(const Obstacle *obs, const short *live, int count, const Viewport *vp, int hidden_lines, double max_dist, Counters *counters,
+                         FogBatch *fog);
+void draw_bullets(const GameState *game, ViewJob *job);
+void draw_particles(const GameState *game, ViewJob *job);
+void draw_crosshair(const Viewport *vp);
+void draw_hud(GameState *game);
+void update_bullets(GameState *game);
+void update_obstacles(GameState *game);
+void stream_chunks(GameState *game);
+void reload_chunks(GameState *game);
+int chunk_slot(int cx, int cz);
+void fire_bullet(GameState *game);
+void check_collisions(GameState *game);
+void spawn_debris(GameState *game, Obstacle *obs, int count, float speed);
+void snapshot_init(SnapshotRing *ring);
+void snapshot_reset(SnapshotRing *ring);
+void snapshot_frame(SnapshotRing *ring, GameState *game);
+int snapshot_rewind(SnapshotRing *ring, GameState *game, int steps);
+void rewind_game(GameState *game, SnapshotRing *ring, int steps);
+void report_snapshots(FILE *f, const SnapshotRing *ring);
+
+#endif
@@ -0,0 +1,559 @@
+/*
+ * 3D Flight Shooter - offline render-to-video mode
+ * Author: Matus Vecera
+ *
+ * Runs the normal game loop with no sleeps and no X window. Each frame is drawn
+ * into the framebuffer backend (gfx_fb.c) and streamed out either as numbered
+ * PPM files or as one Y4M video on stdout, which ffmpeg/mpv read directly:
+ *
+ *   ./render -i flight.txt -o clip_           clip_00000.ppm, clip_00001.ppm ...
+ *   ./render -n 1200 -y | ffmpeg -i - clip.mp4
+ *
+ * Input comes from a recording made with ./project flight.txt, or from a built-in
+ * scripted flight path when no recording is given.
+ *
+ * Output goes through a double-buffered writer thread: while one finished frame
+ * is being written, the next one is rendered into the other buffer, so rendering
+ * only waits on I/O when the disk/pipe is slower than the game.
+ *
+ * It doubles as the headless benchmark: -c writes every frame's work counters
+ * to a CSV file, -b name=limit fails the run (exit status 2) if any frame goes
+ * over the limit, and -d skips writing frames so only the game is measured.
+ * -l draws the terrain one segment per edge instead of as polylines, to compare.
+ * -O renders nothing, it checks that terrain occlusion only hides ground behind
+ * nearer ground (exit status 2 if not).
+ */
+
+#define _XOPEN_SOURCE 500 // for dup2, pthreads and clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "gfx.h"
+#include "gfx_fb.h"
+#include "gfx_font.h"
+#include "project.h"
+
+#define MAX_FRAME_EVENTS 32 // key/click events replayed per frame
+#define DEFAULT_FRAMES 600
+#define DEFAULT_FPS 80 // the interactive loop runs at ~80 FPS
+#define MAX_BUDGETS 16
+
+/* ==================== DOUBLE-BUFFERED WRITER ==================== */
+
+// Two frame-sized buffers shared between the render loop and the writer thread
+typedef struct {
+    unsigned char *buf[2];
+    size_t len[2];
+    int frame[2];          // frame number held in each buffer
+    int full[2];           // 1 = handed to the writer, not written yet
+    int done;              // render loop finished, writer drains and exits
+    int failed;            // a write failed, stop rendering
+    int y4m;               // 1 = one Y4M stream, 0 = numbered PPM files
+    int fd;                // Y4M output
+    const char *prefix;    // PPM file name prefix
+    double stall;          // seconds the render loop waited for the writer
+    double bytes;          // output so far (frames handed to the writer and the Y4M header)
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} FrameWriter;
+
+// write() until everything is out, returns 0 on error
+int write_all(int fd, const unsigned char *data, size_t len) {
+    ssize_t n;
+    while (len > 0) {
+        n = write(fd, data, len);
+        if (n <= 0) return 0;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+// Write one finished buffer: a whole PPM file, or one Y4M frame, in a single write
+int write_frame(FrameWriter *w, int slot) {
+    char name[256];
+    int fd, ok;
+    
+    if (w->y4m) return write_all(w->fd, w->buf[slot], w->len[slot]);
+    
+    snprintf(name, sizeof(name), "%s%05d.ppm", w->prefix, w->frame[slot]);
+    fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) { perror(name); return 0; }
+    ok = write_all(fd, w->buf[slot], w->len[slot]);
+    close(fd);
+    return ok;
+}
+
+// Writer thread: take buffers in order and write them out
+void *writer_thread(void *arg) {
+    FrameWriter *w = arg;
+    int slot = 0;
+    
+    while (1) {
+        pthread_mutex_lock(&w->lock);
+        while (!w->full[slot] && !w->done) pthread_cond_wait(&w->cond, &w->lock);
+        if (!w->full[slot]) { pthread_mutex_unlock(&w->lock); break; }  // done and drained
+        pthread_mutex_unlock(&w->lock);
+        
+        if (!write_frame(w, slot)) {
+            pthread_mutex_lock(&w->lock);
+            w->failed = 1;
+            w->full[0] = w->full[1] = 0;
+            pthread_cond_broadcast(&w->cond);
+            pthread_mutex_unlock(&w->lock);
+            break;
+        }
+        
+        pthread_mutex_lock(&w->lock);
+        w->full[slot] = 0;
+        pthread_cond_broadcast(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+        slot = !slot;
+    }
+    return NULL;
+}
+
+// Wait until a buffer is free for the next frame (this is the only I/O stall)
+unsigned char *writer_acquire(FrameWriter *w, int slot) {
+    double t0 = now_seconds();
+    pthread_mutex_lock(&w->lock);
+    while (w->full[slot] && !w->failed) pthread_cond_wait(&w->cond, &w->lock);
+    pthread_mutex_unlock(&w->lock);
+    w->stall += now_seconds() - t0;
+    return w->failed ? NULL : w->buf[slot];
+}
+
+// Hand a filled buffer to the writer
+void writer_submit(FrameWriter *w, int slot, size_t len, int frame) {
+    pthread_mutex_lock(&w->lock);
+    w->len[slot] = len;
+    w->bytes += len;
+    w->frame[slot] = frame;
+    w->full[slot] = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/* ==================== FRAME ENCODING ==================== */
+
+// Binary PPM: header followed by the raw RGB framebuffer
+size_t encode_ppm(unsigned char *out, const unsigned char *rgb, int w, int h) {
+    int n = sprintf((char *)out, "P6\n%d %d\n255\n", w, h);
+    memcpy(out + n, rgb, (size_t)w * h * 3);
+    return n + (size_t)w * h * 3;
+}
+
+// Y4M frame: full-range BT.601 Y plane, then Cb and Cr averaged over 2x2 blocks
+size_t encode_y4m(unsigned char *out, const unsigned char *rgb, int w, int h) {
+    unsigned char *Y, *U, *V;
+    const unsigned char *p, *q;
+    int x, y, r, g, b;
+    
+    memcpy(out, "FRAME\n", 6);
+    Y = out + 6;
+    U = Y + w * h;
+    V = U + (w / 2) * (h / 2);
+    
+    for (y = 0; y < h; y++) {
+        p = rgb + (size_t)y * w * 3;
+        for (x = 0; x < w; x++, p += 3) {
+            Y[y * w + x] = (unsigned char)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+        }
+    }
+    for (y = 0; y < h / 2; y++) {
+        p = rgb + (size_t)(2 * y) * w * 3;
+        q = p + w * 3;
+        for (x = 0; x < w / 2; x++, p += 6, q += 6) {
+            r = p[0] + p[3] + q[0] + q[3];
+            g = p[1] + p[4] + q[1] + q[4];
+            b = p[2] + p[5] + q[2] + q[5];
+            U[y * (w / 2) + x] = (unsigned char)((-43 * r - 85 * g + 128 * b + 4 * 128 * 256 + 511) >> 10);
+            V[y * (w / 2) + x] = (unsigned char)((128 * r - 107 * g - 21 * b + 4 * 128 * 256 + 511) >> 10);
+        }
+    }
+    return 6 + (size_t)w * h + 2 * (size_t)(w / 2) * (h / 2);
+}
+
+/* ==================== INPUT ==================== */
+
+// Read one recorded frame: "mouse_x mouse_y [event ...]", returns 0 at end of file
+int read_recorded_frame(FILE *in, int *mx, int *my, char *events, int *nevents) {
+    char line[1024];
+    char *p;
+    int used, ev;
+    
+    if (!fgets(line, sizeof(line), in)) return 0;
+    if (sscanf(line, "%d %d%n", mx, my, &used) != 2) return 0;
+    p = line + used;
+    *nevents = 0;
+    while (*nevents < MAX_FRAME_EVENTS && sscanf(p, "%d%n", &ev, &used) == 1) {
+        events[(*nevents)++] = (char)ev;
+        p += used;
+    }
+    return 1;
+}
+
+// Scripted flight: weave left and right, hold ~120 units above the ground, shoot now and then
+void scripted_frame(GameState *game, int frame, int *mx, int *my, char *events, int *nevents) {
+    double ground = get_terrain_height(game, game->camera.position.x, game->camera.position.z);
+    double want_pitch = (ground + 120.0 - game->camera.position.y) * 0.004;
+    int dy;
+    
+    if (want_pitch > 0.3) want_pitch = 0.3;
+    if (want_pitch < -0.3) want_pitch = -0.3;
+    dy = (int)((want_pitch - game->camera.pitch) * 3000.0);
+    if (dy > SCREEN_CY) dy = SCREEN_CY;
+    if (dy < -SCREEN_CY) dy = -SCREEN_CY;
+    
+    *mx = SCREEN_CX + (int)(150.0 * sin(frame * 0.01));
+    *my = SCREEN_CY + dy;
+    *nevents = 0;
+    if (frame % 25 == 0) events[(*nevents)++] = 1;  // click = shoot
+}
+
+/* ==================== BUDGETS ==================== */
+
+// A per-frame limit on one counter, from -b name=limit
+typedef struct {
+    int counter;      // index into Counters
+    int limit;
+    int peak, peak_frame;
+    int frames_over;  // frames that went over the limit
+} Budget;
+
+// Parse "name=limit", returns 0 if it is not a known counter
+int parse_budget(const char *arg, Budget *b) {
+    char name[64];
+    
+    if (sscanf(arg, "%63[^=]=%d", name, &b->limit) != 2) return 0;
+    b->counter = counter_lookup(name);
+    b->peak = -1;
+    b->peak_frame = 0;
+    b->frames_over = 0;
+    return b->counter >= 0;
+}
+
+// Check one frame's counters against every budget
+void check_budgets(Budget *budgets, int count, const Counters *c, int frame) {
+    int i, value;
+    
+    for (i = 0; i < count; i++) {
+        value = counter_value(c, budgets[i].counter);
+        if (value > budgets[i].peak) {
+            budgets[i].peak = value;
+            budgets[i].peak_frame = frame;
+        }
+        if (value > budgets[i].limit) budgets[i].frames_over++;
+    }
+}
+
+// Print how every budget did, returns how many were broken
+int report_budgets(Budget *budgets, int count) {
+    int i, failed = 0;
+    
+    for (i = 0; i < count; i++) {
+        fprintf(stderr, "  budget %s <= %d: peak %d at frame %d, %s\n", counter_name(budgets[i].counter),
+                budgets[i].limit, budgets[i].peak, budgets[i].peak_frame,
+                budgets[i].frames_over ? "FAILED" : "ok");
+        if (budgets[i].frames_over) {
+            fprintf(stderr, "    over the limit in %d frames\n", budgets[i].frames_over);
+            failed++;
+        }
+    }
+    return failed;
+}
+
+/* ==================== OCCLUSION CHECK ==================== */
+
+// ./render -O draws the terrain on its own at a sweep of headings and pitches, once
+// with occlusion off and once on. With fog on, a terrain pixel's green channel says
+// which distance bucket it is in. Occlusion may only take away a pixel that has
+// terrain at least as near (one bucket of slack, an edge carries one end's shade)
+// drawn above it in its column, anything else is nearer ground hidden by farther ground.
+// The horizon is sampled per column and the lines are drawn by gfx, so the two can
+// disagree by a pixel: terrain up to CHECK_SLACK pixels below still counts as above
+// (and the bottom CHECK_SLACK rows, with nothing below them on screen, are not checked).
+// A row seen end-on can come out on either side of the rows next to it when the view
+// is tilted, so a view may have up to CHECK_STRAYS such pixels.
+
+#define CHECK_HEADINGS 72
+#define CHECK_SLACK 2
+#define CHECK_STRAYS 8
+
+// Fog bucket of a terrain pixel, -1 for background
+int terrain_bucket(const unsigned char *p) {
+    int k;
+    
+    for (k = 0; k < FOG_BUCKETS; k++) {
+        if (p[1] == (int)(255 * (1.0 - 0.8 * k / (FOG_BUCKETS - 1)))) return k;
+    }
+    return -1;
+}
+
+// Draw the terrain alone into the framebuffer and keep a copy of it
+void check_draw(GameState *game, const TerrainSet *set, ViewJob *job, unsigned char *copy) {
+    job->list.n = 0;
+    draw_terrain(game, set, job);
+    gfx_clear();
+    draw_list_play(&job->list);
+    memcpy(copy, gfx_fb_pixels(), (size_t)SCREEN_WIDTH * SCREEN_HEIGHT * 3);
+}
+
+// Check the view from the game's camera, returns the pixels hidden with no nearer terrain above them
+int check_view(GameState *game, int *removed) {
+    static TerrainSet set;
+    static ViewJob job; // its draw list is kept for the next view
+    static unsigned char off[SCREEN_WIDTH * SCREEN_HEIGHT * 3], on[SCREEN_WIDTH * SCREEN_HEIGHT * 3];
+    int x, y, k, above, wrong = 0;
+    
+    setup_viewports(game, &job.vp);
+    build_terrain(game, &set);
+    project_terrain(&set, &job.vp, &job.view);
+    game->terrain_occlusion = 0;
+    check_draw(game, &set, &job, off);
+    game->terrain_occlusion = 1;
+    check_draw(game, &set, &job, on);
+    
+    *removed = 0;
+    for (x = 0; x < SCREEN_WIDTH; x++) {
+        above = FOG_BUCKETS; // nearest bucket drawn above y (give or take CHECK_SLACK) in this column
+        for (y = 0; y + CHECK_SLACK < SCREEN_HEIGHT; y++) {
+            k = terrain_bucket(&on[((y + CHECK_SLACK) * SCREEN_WIDTH + x) * 3]);
+            if (k >= 0 && k < above) above = k;
+            if (terrain_bucket(&on[(y * SCREEN_WIDTH + x) * 3]) >= 0) continue;
+            k = terrain_bucket(&off[(y * SCREEN_WIDTH + x) * 3]);
+            if (k < 0) continue;
+            (*removed)++;
+            if (above > k + 1) wrong++;
+        }
+    }
+    return wrong;
+}
+
+// Returns how many views failed
+int occlusion_check(GameState *game) {
+    static const double pitches[] = {0.0, 0.25, -0.25};
+    static const double altitudes[] = {60.0, 240.0}; // above the ground
+    int a, p, h, wrong, removed, failed = 0, views = 0;
+    double ground = get_terrain_height(game, game->camera.position.x, game->camera.position.z);
+    
+    game->fog = 1;
+    game->view_mode = 0;
+    gfx_clear_color(0, 0, 0);
+    for (views = 0; views < 2 * 3 * CHECK_HEADINGS; views++) {
+        a = views / (3 * CHECK_HEADINGS);
+        p = views / CHECK_HEADINGS % 3;
+        h = views % CHECK_HEADINGS;
+        game->camera.position.y = ground + altitudes[a];
+        game->camera.pitch = pitches[p];
+        game->camera.yaw = 2.0 * PI * h / CHECK_HEADINGS - PI;
+        update_camera_trig(&game->camera);
+        wrong = check_view(game, &removed);
+        if (wrong > CHECK_STRAYS) {
+            fprintf(stderr, "  altitude %3.0f yaw %6.3f pitch %5.2f: %d of %d removed pixels had no nearer terrain above them\n",
+                    altitudes[a], game->camera.yaw, game->camera.pitch, wrong, removed);
+            failed++;
+        }
+    }
+    fprintf(stderr, "Occlusion check: %d of %d views hid nearer terrain behind farther terrain\n", failed, views);
+    return failed;
+}
+
+/* ==================== MAIN FUNCTION ==================== */
+
+void usage(const char *prog) {
+    int i;
+    
+    fprintf(stderr, "Usage: %s [-i record.txt] [-n frames] [-o prefix | -y | -d] [-s seed] [-f fps]\n", prog);
+    fprintf(stderr, "          [-c counters.csv] [-b counter=limit ...] [-l]\n");
+    fprintf(stderr, "       %s -O\n", prog);
+    fprintf(stderr, "  -i file    replay a recording made with ./project file (default: scripted flight)\n");
+    fprintf(stderr, "  -n frames  number of frames to render (default %d)\n", DEFAULT_FRAMES);
+    fprintf(stderr, "  -o prefix  write prefix00000.ppm, prefix00001.ppm, ... (default frame_)\n");
+    fprintf(stderr, "  -y         write one Y4M stream to stdout instead\n");
+    fprintf(stderr, "  -s seed    random seed for the scripted flight (recordings carry their own)\n");
+    fprintf(stderr, "  -d         do not write frames at all (benchmark)\n");
+    fprintf(stderr, "  -f fps     frame rate written in the Y4M header (default %d)\n", DEFAULT_FPS);
+    fprintf(stderr, "  -l         terrain as one segment per edge, not row/column polylines (same as L)\n");
+    fprintf(stderr, "  -c file    write every frame's work counters to a CSV file\n");
+    fprintf(stderr, "  -O         check that terrain occlusion only hides what nearer terrain covers\n");
+    fprintf(stderr, "  -b c=n     fail (exit status 2) if counter c goes over n in any frame, counters:\n");
+    fprintf(stderr, "            ");
+    for (i = 0; i < COUNTERS; i++) fprintf(stderr, " %s", counter_name(i));
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[]) {
+    GameState game;
+    FrameWriter w;
+    Atlas portraits;
+    SnapshotRing snapshots; // B in a recording rewinds, same as in the game
+    ViewWorkers workers;
+    pthread_t thread;
+    FILE *in = NULL;
+    FILE *csv = NULL; // per-frame counters
+    Budget budgets[MAX_BUDGETS];
+    char events[MAX_FRAME_EVENTS];
+    char header[128];
+    unsigned char *out;
+    size_t frame_bytes;
+    int frames = DEFAULT_FRAMES, fps = DEFAULT_FPS;
+    unsigned int seed = 1;
+    int frame, slot = 0, nevents, mx, my, i, opt, result, quit = 0;
+    int dry = 0, nbudgets = 0, failed = 0, text_hits, text_misses, strips = 1, check = 0;
+    double lines = 0.0, points = 0.0; // sent to gfx over the whole run
+    double t_start, t_render = 0.0, t0, elapsed, frame_ms;
+    
+    memset(&w, 0, sizeof(w));
+    w.prefix = "frame_";
+    while ((opt = getopt(argc, argv, "i:n:o:yds:f:c:b:lO")) != -1) {
+        if (opt == 'i') {
+            in = fopen(optarg, "r");
+            if (!in) { perror(optarg); return 1; }
+        } else if (opt == 'n') frames = atoi(optarg);
+        else if (opt == 'o') w.prefix = optarg;
+        else if (opt == 'y') w.y4m = 1;
+        else if (opt == 's') seed = (unsigned int)strtoul(optarg, NULL, 10);
+        else if (opt == 'f') fps = atoi(optarg);
+        else if (opt == 'd') dry = 1;
+        else if (opt == 'l') strips = 0;
+        else if (opt == 'O') check = 1;
+        else if (opt == 'c') {
+            csv = fopen(optarg, "w");
+            if (!csv) { perror(optarg); return 1; }
+            counters_csv_header(csv);
+        } else if (opt == 'b' && nbudgets < MAX_BUDGETS && parse_budget(optarg, &budgets[nbudgets])) {
+            nbudgets++;
+        }
+        else { usage(argv[0]); return 1; }
+    }
+    if (in && fscanf(in, "seed %u\n", &seed) != 1) {
+        fprintf(stderr, "recording has no seed line\n");
+        return 1;
+    }
+    
+    // The video owns stdout, so the game's own messages go to stderr
+    if (w.y4m && !dry) {
+        w.fd = dup(1);
+        dup2(2, 1);
+        snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", SCREEN_WIDTH, SCREEN_HEIGHT, fps);
+        if (!write_all(w.fd, (unsigned char *)header, strlen(header))) return 1;
+        w.bytes += strlen(header);
+    }
+    
+    default_tuning(&game);
+    seed_game(&game, seed);
+    init_game(&game);
+    init_settings(&game, 0.0);  // fixed detail, so videos look the same on every machine
+    game.terrain_strips = strips;
+    if (check) {
+        gfx_open(SCREEN_WIDTH, SCREEN_HEIGHT, "render");
+        return occlusion_check(&game) ? 2 : 0;
+    }
+    snapshot_init(&snapshots);
+    if (!atlas_open(&portraits, "portraits.atlas")) {
+        fprintf(stderr, "portraits.atlas not found (run make), the win screen will have no pictures\n");
+    }
+    gfx_open(SCREEN_WIDTH, SCREEN_HEIGHT, "render");
+    view_workers_start(&workers);
+    
+    frame_bytes = 64 + (size_t)SCREEN_WIDTH * SCREEN_HEIGHT * 3;  // fits either format
+    for (i = 0; i < 2; i++) {
+        w.buf[i] = malloc(frame_bytes);
+        if (!w.buf[i]) return 1;
+    }
+    pthread_mutex_init(&w.lock, NULL);
+    pthread_cond_init(&w.cond, NULL);
+    pthread_create(&thread, NULL, writer_thread, &w);
+    
+    t_start = now_seconds();
+    for (frame = 0; frame < frames && !quit; frame++) {
+        t0 = now_seconds();
+        if (in) {
+            if (!read_recorded_frame(in, &mx, &my, events, &nevents)) break;
+        } else {
+            scripted_frame(&game, frame, &mx, &my, events, &nevents);
+        }
+        
+        // Same order as the interactive loop in main.c: input first, then update and draw
+        for (i = 0; i < nevents && !quit; i++) {
+            if (events[i] == 'b' || events[i] == 'B') rewind_game(&game, &snapshots, REWIND_STEPS);
+            quit = handle_key(&game, events[i]);
+        }
+        if (quit) break;
+        result = simulate_frame(&game, mx, my);
+        report_events(&game);
+        if (result == SIM_LOST) {
+            game.final_time = (int)(time(NULL) - game.start_time);
+            draw_lose_screen(&game);
+            quit = 1;
+        } else if (result == SIM_WON) {
+            game.show_Win_Screen = 1;
+            game.final_time = (int)(time(NULL) - game.start_time);
+            draw_win_screen(&game, &portraits);
+            quit = 1;
+        } else {
+            snapshot_frame(&snapshots, &game);
+            draw_frame(&game, &workers);
+        }
+        gfx_flush();
+        
+        frame_ms = (now_seconds() - t0) * 1000.0;
+        lines += game.counters.segments;
+        points += game.counters.vertices_submitted;
+        if (csv) counters_csv_row(csv, frame, frame_ms, &game.counters);
+        check_budgets(budgets, nbudgets, &game.counters, frame);
+        if (dry) {
+            t_render += now_seconds() - t0;
+            continue;
+        }
+        
+        out = writer_acquire(&w, slot);
+        if (!out) break;
+        if (w.y4m) {
+            writer_submit(&w, slot, encode_y4m(out, gfx_fb_pixels(), SCREEN_WIDTH, SCREEN_HEIGHT), frame);
+        } else {
+            writer_submit(&w, slot, encode_ppm(out, gfx_fb_pixels(), SCREEN_WIDTH, SCREEN_HEIGHT), frame);
+        }
+        slot = !slot;
+        t_render += now_seconds() - t0;
+    }
+    
+    pthread_mutex_lock(&w.lock);
+    w.done = 1;
+    pthread_cond_broadcast(&w.cond);
+    pthread_mutex_unlock(&w.lock);
+    pthread_join(thread, NULL);
+    elapsed = now_seconds() - t_start;
+    view_workers_stop(&workers);
+    
+    if (dry) {
+        fprintf(stderr, "Rendered %d frames in %.2f s: %.1f frames/sec (nothing written)\n",
+                frame, elapsed, frame / elapsed);
+    } else {
+        fprintf(stderr, "Rendered %d frames in %.2f s: %.1f frames/sec (%.1f MB/s)\n",
+                frame, elapsed, frame / elapsed, w.bytes / elapsed / 1e6);
+        fprintf(stderr, "  render+encode %.2f s, waiting on output %.2f s\n", t_render - w.stall, w.stall);
+    }
+    report_snapshots(stderr, &snapshots);
+    if (frame > 0) {
+        fprintf(stderr, "Lines: %.0f per frame sent as %.0f vertices (terrain as %s)\n", lines / frame,
+                points / frame, game.terrain_strips ? "row/column polylines" : "one segment per edge");
+    }
+    gfx_text_stats(&text_hits, &text_misses);
+    fprintf(stderr, "Text: %d strings drawn from the layout cache, %d laid out\n", text_hits, text_misses);
+    failed = report_budgets(budgets, nbudgets);
+    
+    if (in) fclose(in);
+    if (csv) fclose(csv);
+    if (w.y4m && !dry) close(w.fd);
+    free(w.buf[0]);
+    free(w.buf[1]);
+    if (w.failed) return 1;
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * 3D Flight Shooter - image scaling for the portrait atlas
+ * Author: Matus Vecera
+ *
+ * See scale.h. Both scalers work a whole row at a time:
+ *   nearest - the source column of every output column is worked out once
+ *             (16.16 fixed point, one add per column) and reused for all rows,
+ *             a row is then just a gather through that table
+ *   box     - each source row is added into one or two output row sums with its
+ *             integer coverage weight (a plain loop over the row the compiler
+ *             vectorizes, this is where nearly all the work is), and a finished
+ *             output row is squeezed horizontally the same way and divided
+ *
+ * Box weights are exact integer areas: with source pixel i covering [i*dw, (i+1)*dw)
+ * and output pixel x covering [x*sw, (x+1)*sw) every overlap is a whole number and
+ * every output pixel adds up to exactly sw*sh. No rounding until the final divide.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "scale.h"
+
+// 16.16 step from one output pixel to the next, rounded up so that for outputs up to
+// 256 pixels it picks exactly the pixel floor(d * s / dn) would (the old sampling)
+unsigned int fixed_step(int s, int dn) {
+    return (unsigned int)((((unsigned long)s << 16) + dn - 1) / dn);
+}
+
+// Nearest neighbour to dw x dh, returns 0 if out of memory
+int scale_nearest(const unsigned char *src, int sw, int sh, unsigned char *dst, int dw, int dh) {
+    int *col = malloc((size_t)dw * sizeof(int));
+    unsigned int fx, fy, xstep = fixed_step(sw, dw), ystep = fixed_step(sh, dh);
+    const unsigned char *row;
+    int dx, dy;
+    
+    if (!col) return 0;
+    for (dx = 0, fx = 0; dx < dw; dx++, fx += xstep) col[dx] = (int)(fx >> 16) * 3;
+    
+    for (dy = 0, fy = 0; dy < dh; dy++, fy += ystep) {
+        row = src + (size_t)(fy >> 16) * sw * 3;
+        for (dx = 0; dx < dw; dx++) {
+            dst[0] = row[col[dx]];
+            dst[1] = row[col[dx] + 1];
+            dst[2] = row[col[dx] + 2];
+            dst += 3;
+        }
+    }
+    free(col);
+    return 1;
+}
+
+// Squeeze one vertically summed row (sw pixels) to dw pixels and divide by the area
+void box_emit(const unsigned int *sum, int sw, const int *col, const unsigned int *weight,
+              unsigned int *out, int dw, unsigned int area, unsigned char *dst) {
+    int i, c, k;
+    
+    memset(out, 0, (size_t)(dw + 1) * 3 * sizeof(unsigned int));
+    for (i = 0; i < sw; i++) {
+        k = col[i] * 3;
+        for (c = 0; c < 3; c++) {
+            out[k + c] += weight[i] * sum[i * 3 + c];
+            out[k + 3 + c] += ((unsigned int)dw - weight[i]) * sum[i * 3 + c];
+        }
+    }
+    for (k = 0; k < dw * 3; k++) dst[k] = (unsigned char)((out[k] + area / 2) / area);
+}
+
+// Area average down to dw x dh (dw <= sw, dh <= sh)
+// Returns 0 if out of memory, or if the image is so big (over ~16 Mpixels) that the
+// 32-bit sums could overflow
+int scale_box(const unsigned char *src, int sw, int sh, unsigned char *dst, int dw, int dh) {
+    size_t rowlen = (size_t)sw * 3;
+    unsigned int *sums, *cur, *next, *tmp, *out, *weight;
+    unsigned int area = (unsigned int)sw * sh, v0, v1;
+    const unsigned char *row;
+    int *col, i, sy, dy = 0;
+    long t, b;
+    size_t k;
+    
+    if (dw > sw || dh > sh || (double)sw * sh * 255.0 > UINT_MAX) return 0;
+    sums = calloc(rowlen * 2 + (size_t)(dw + 1) * 3 + sw, sizeof(unsigned int));
+    col = malloc((size_t)sw * sizeof(int));
+    if (!sums || !col) { free(sums); free(col); return 0; }
+    cur = sums;
+    next = cur + rowlen;
+    out = next + rowlen;
+    weight = out + (size_t)(dw + 1) * 3;
+    
+    // Source column i goes to output col[i] with weight[i] and to col[i]+1 with dw - weight[i]
+    for (i = 0; i < sw; i++) {
+        t = (long)(i + 1) * dw;
+        col[i] = (int)((long)i * dw / sw);
+        b = (long)(col[i] + 1) * sw;
+        weight[i] = (unsigned int)((t <= b ? t : b) - (long)i * dw);
+    }
+    
+    for (sy = 0; sy < sh; sy++) {
+        row = src + (size_t)sy * rowlen;
+        t = (long)(sy + 1) * dh; // where this source row ends
+        b = (long)(dy + 1) * sh; // where the current output row ends
+        v0 = (unsigned int)(t <= b ? dh : b - (long)sy * dh);
+        v1 = (unsigned int)dh - v0;
+        
+        for (k = 0; k < rowlen; k++) cur[k] += v0 * row[k];
+        if (v1) for (k = 0; k < rowlen; k++) next[k] += v1 * row[k];
+        
+        if (t >= b) { // output row dy is complete
+            box_emit(cur, sw, col, weight, out, dw, area, dst + (size_t)dy * dw * 3);
+            dy++;
+            tmp = cur;
+            cur = next;
+            next = tmp;
+            memset(next, 0, rowlen * sizeof(unsigned int));
+        }
+    }
+    free(col);
+    free(sums);
+    return 1;
+}
+
+// Box filter for shrinking, nearest neighbour otherwise (or if box could not run)
+int scale_image(const unsigned char *src, int sw, int sh, unsigned char *dst, int dw, int dh) {
+    if (dw <= sw && dh <= sh && scale_box(src, sw, sh, dst, dw, dh)) return 1;
+    return scale_nearest(src, sw, sh, dst, dw, dh);
+}
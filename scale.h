@@ -0,0 +1,21 @@
+/*
+ * 3D Flight Shooter - image scaling for the portrait atlas
+ * Author: Matus Vecera
+ *
+ * Both scalers take packed RGB (3 bytes per pixel, row major) and write a
+ * dw x dh image into dst.
+ *   scale_nearest - nearest neighbour, stepping through the source in 16.16
+ *                   fixed point (no floating point per pixel)
+ *   scale_box     - area average (box filter), every source pixel counts with
+ *                   exactly the area it covers, for shrinking without aliasing
+ * scale_image picks box for shrinking and nearest for enlarging.
+ */
+
+#ifndef SCALE_H
+#define SCALE_H
+
+int scale_nearest(const unsigned char *src, int sw, int sh, unsigned char *dst, int dw, int dh);
+int scale_box(const unsigned char *src, int sw, int sh, unsigned char *dst, int dw, int dh);
+int scale_image(const unsigned char *src, int sw, int sh, unsigned char *dst, int dw, int dh);
+
+#endif
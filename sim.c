@@ -0,0 +1,507 @@
+/*
+ * 3D Flight Shooter - game simulation
+ * Author: Matus Vecera
+ *
+ * Everything that moves the game forward: flying, bullets, obstacles, hits and
+ * crashes. Nothing in here draws or prints, what happened in a frame is left in
+ * game->events for the front end to show. Each game carries its own random
+ * numbers, so many games can be simulated at once on different threads (batch.c).
+ */
+
+#define _XOPEN_SOURCE 500 // for clock_gettime
+#include <tgmath.h> // sin/cos pick the float versions in the float build
+#include <string.h> // for memset
+#include <time.h> // for time()
+#include "project.h"
+
+/* ==================== INITIALIZATION ==================== */
+
+// Place the local origin at world (x, z) and recompute the terrain phases
+// The phases are reduced in double, so they stay exact however far we fly
+void set_origin(GameState *game, double x, double z) {
+    game->origin_x = x;
+    game->origin_z = z;
+    game->phase_x = (real)fmod(x * 0.01, 2.0 * PI);
+    game->phase_z = (real)fmod(z * 0.01, 2.0 * PI);
+    game->phase_xz = (real)fmod(x * 0.03 + z * 0.02, 2.0 * PI);
+}
+
+void init_game(GameState *game) {
+    int i;
+    //set up the initial conditions of the game
+    game->camera.position.x = 0.0; // Start at origin
+    game->camera.position.y = 300.0;  // Start higher
+    game->camera.position.z = 0.0; // Start at origin
+    game->camera.pitch = 0.0;  // Looking straight ahead
+    game->camera.yaw = 0.0; // Facing along +Z axis
+    game->camera.speed = game->tuning.start_speed; // Moderate speed
+    set_origin(game, 0.0, 0.0); // local coordinates = world coordinates
+    
+    game->score = 0;
+    game->lives = 3;
+    game->is_moving = 1;
+    game->show_Win_Screen = 0;
+    game->game_over = 0;
+    game->start_time = time(NULL);
+    game->final_time = 0;
+    game->events.hits = 0;
+    game->events.collisions = 0;
+    game->events.crashed = 0;
+    particles_init(&game->particles);
+    
+    for (i = 0; i < MAX_BULLETS; i++) { //initialize bullets
+        game->bullets[i].active = 0;
+    }
+    
+    // A new world for every game, but the same one for the same seed
+    game->world_seed = (unsigned int)game_rand(game) << 15;
+    game->world_seed ^= (unsigned int)game_rand(game);
+    game->tick = 0;
+    game->kill_count = 0;
+    game->kill_next = 0;
+    reload_chunks(game); //initialize obstacles
+}
+
+// Difficulty knobs with the values the game was balanced with
+// Set once before init_game, the batch runner overrides them to try other values
+void default_tuning(GameState *game) {
+    game->tuning.chunk_cubes = 2;
+    game->tuning.hit_scale = 1.0;
+    game->tuning.player_radius = 20.0;
+    game->tuning.start_speed = START_SPEED;
+    game->tuning.rebase_distance = REBASE_DISTANCE;
+}
+
+// Start the game's random number sequence, same seed = same game
+void seed_game(GameState *game, unsigned int seed) {
+    game->rng = seed;
+}
+
+// Next random number from the game's own sequence, 0 to 32767
+// (the example rand() from the C standard, kept per game instead of one global)
+int game_rand(GameState *game) {
+    game->rng = game->rng * 1103515245u + 12345u;
+    return (int)((game->rng / 65536u) % 32768u);
+}
+
+// Current time in seconds (monotonic), for frame timing
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* ==================== FRAME STEP ==================== */
+// The interactive game, the offline renderer and the batch runner all step the game
+// through simulate_frame, after they have applied this frame's keys/clicks
+
+// Run one frame: fly toward the mouse, then (if still playing) move bullets and
+// obstacles and check hits. Returns SIM_LOST on a crash or no lives left, SIM_WON
+// the first frame the score reaches WIN_SCORE, otherwise SIM_PLAYING.
+int simulate_frame(GameState *game, int mouse_x, int mouse_y) {
+    game->events.hits = 0;
+    game->events.collisions = 0;
+    game->events.crashed = 0;
+    memset(&game->counters, 0, sizeof(game->counters));
+    
+    update_camera(game, mouse_x, mouse_y);
+    check_ground(game);
+    if (game->game_over) return SIM_LOST;
+    if (game->score >= WIN_SCORE && !game->show_Win_Screen) return SIM_WON;
+    
+    update_bullets(game);
+    update_obstacles(game);
+    particles_update(&game->particles);
+    check_collisions(game);
+    return SIM_PLAYING;
+}
+
+// Screen y the mouse steers from: the middle of the player's view, where the crosshair is
+// (split screen gives the front view the top half, so it is higher up there)
+int steer_center_y(const GameState *game) {
+    return game->view_mode == 2 ? SCREEN_CY / 2 : SCREEN_CY;
+}
+
+// Steer toward the mouse and fly forward one frame
+void update_camera(GameState *game, int mouse_x, int mouse_y) {
+    real target_yaw, target_pitch; // desired camera angles based on mouse
+    
+    // Calculate how much to turn based on mouse offset from the crosshair
+    // Mouse left of center = turn left (negative yaw change)
+    target_yaw = (mouse_x - SCREEN_CX) * 0.0008;  // Scale mouse offset to rotation
+    target_pitch = (mouse_y - steer_center_y(game)) * 0.0006;  // Pitch based on vertical offset
+    
+    // Smoothly steer toward mouse direction
+    game->camera.yaw += target_yaw * STEER_SPEED;
+    game->camera.pitch += target_pitch * STEER_SPEED;
+    
+    // Clamp pitch, which is more limited than yaw
+    if (game->camera.pitch < -1.2) game->camera.pitch = -1.2;
+    if (game->camera.pitch > 0.8) game->camera.pitch = 0.8;
+    
+    // Update trig values (used for movement and rendering)
+    update_camera_trig(&game->camera);
+    
+    // Always move forward - I am flying!
+    game->camera.position.x += game->camera.speed * game->camera.sin_yaw * game->camera.cos_pitch;
+    game->camera.position.z += game->camera.speed * game->camera.cos_yaw * game->camera.cos_pitch;
+    game->camera.position.y += game->camera.speed * game->camera.sin_pitch;
+    
+    rebase_origin(game);
+}
+
+// Update precomputed trig values for camera
+void update_camera_trig(Camera *cam) {
+    cam->cos_pitch = cos(cam->pitch);
+    cam->sin_pitch = sin(cam->pitch);
+    cam->cos_yaw = cos(cam->yaw);
+    cam->sin_yaw = sin(cam->yaw);
+}
+
+// Keep coordinates small: once the camera is rebase_distance (REBASE_DISTANCE) from the
+// local origin, move the origin under the camera. Camera, bullets and obstacles shift by
+// the same whole number of units (exact in float too) and the terrain phases absorb the
+// shift, so nothing moves. The phases are reduced mod 2*PI, so terrain heights can differ
+// in the last bits from an unshifted run, the long-flight check (batch -L) measures it.
+void rebase_origin(GameState *game) {
+    double shiftX = 0.0, shiftZ = 0.0, limit = game->tuning.rebase_distance;
+    int i;
+    
+    if (limit <= 0.0) return;
+    if (fabs(game->camera.position.x) > limit) shiftX = floor(game->camera.position.x);
+    if (fabs(game->camera.position.z) > limit) shiftZ = floor(game->camera.position.z);
+    if (shiftX == 0.0 && shiftZ == 0.0) return;
+    
+    game->camera.position.x -= shiftX;
+    game->camera.position.z -= shiftZ;
+    for (i = 0; i < MAX_BULLETS; i++) {
+        game->bullets[i].position.x -= shiftX;
+        game->bullets[i].position.z -= shiftZ;
+    }
+    for (i = 0; i < MAX_OBSTACLES; i++) {
+        game->obstacles[i].position.x -= shiftX;
+        game->obstacles[i].position.z -= shiftZ;
+    }
+    particles_shift(&game->particles, (float)shiftX, (float)shiftZ);
+    set_origin(game, game->origin_x + shiftX, game->origin_z + shiftZ);
+}
+
+// Check ground collision = death
+void check_ground(GameState *game) {
+    double ground = get_terrain_height(game, game->camera.position.x, game->camera.position.z) + 15;
+    if (game->camera.position.y < ground) {
+        game->game_over = 1;
+        game->events.crashed = 1;
+    }
+}
+
+/* ==================== TERRAIN ==================== */
+
+// Simple procedural terrain height function
+// x and z are local, the phases carry the world origin
+real get_terrain_height(GameState *game, real x, real z) {
+    game->counters.terrain_heights++;
+    // Sine wave terrain
+    return (real)30.0 * sin(x * (real)0.01 + game->phase_x) * sin(z * (real)0.01 + game->phase_z) +
+           (real)15.0 * sin(x * (real)0.03 + z * (real)0.02 + game->phase_xz);
+}
+
+/* ==================== OBSTACLES ==================== */
+// The world is cut into CHUNK_SIZE squares and every chunk places its own cubes from
+// a hash of (world_seed, chunk x, chunk z), so the same place always has the same cubes.
+// Only the 9x9 chunks around the camera are loaded, out past OBSTACLE_DISTANCE. Chunk
+// (cx, cz) always lands in slot (cx mod 9, cz mod 9), so when the camera crosses into
+// the next chunk the row (or column) it left behind is exactly the slots the new row needs: those chunks are
+// retired and the new ones placed, the rest of the frames do no spawning work at all.
+
+// Mix the chunk coordinates and a field number into the seed, a different
+// well scrambled number for every (seed, cx, cz, n)
+unsigned int chunk_hash(unsigned int seed, int cx, int cz, int n) {
+    unsigned int h = seed;
+    h ^= (unsigned int)cx + 0x9e3779b9u + (h << 6) + (h >> 2);
+    h ^= (unsigned int)cz + 0x9e3779b9u + (h << 6) + (h >> 2);
+    h ^= (unsigned int)n + 0x9e3779b9u + (h << 6) + (h >> 2);
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+// Slot a chunk always goes into
+int chunk_slot(int cx, int cz) {
+    return ((cx % CHUNK_SIDE + CHUNK_SIDE) % CHUNK_SIDE) * CHUNK_SIDE + (cz % CHUNK_SIDE + CHUNK_SIDE) % CHUNK_SIDE;
+}
+
+// Was cube k of chunk (cx, cz) destroyed already?
+int cube_killed(GameState *game, int cx, int cz, int k) {
+    int i;
+    for (i = 0; i < game->kill_count; i++) {
+        if (game->kills[i].cx == cx && game->kills[i].cz == cz && game->kills[i].k == k) return 1;
+    }
+    return 0;
+}
+
+// Remember that obstacles[j] was destroyed, so reloading its chunk leaves it out
+void record_kill(GameState *game, int j) {
+    int slot = j / CHUNK_CUBES_MAX;
+    CubeKill *kill = &game->kills[game->kill_next];
+    
+    kill->cx = game->chunks.cx[slot];
+    kill->cz = game->chunks.cz[slot];
+    kill->k = j % CHUNK_CUBES_MAX;
+    game->kill_next = (game->kill_next + 1) % MAX_KILLS;
+    if (game->kill_count < MAX_KILLS) game->kill_count++;
+}
+
+// Put chunk (cx, cz) into its slot, retiring whatever chunk was there
+void load_chunk(GameState *game, int cx, int cz) {
+    int slot = chunk_slot(cx, cz), count, k;
+    int cubes = game->tuning.chunk_cubes < CHUNK_CUBES_MAX ? game->tuning.chunk_cubes : CHUNK_CUBES_MAX;
+    Obstacle *obs = &game->obstacles[slot * CHUNK_CUBES_MAX];
+    double wx, wz; // world position of the cube
+    
+    game->chunks.cx[slot] = cx;
+    game->chunks.cz[slot] = cz;
+    game->chunks.loaded[slot] = 1;
+    game->counters.chunks_loaded++;
+    
+    count = (int)(chunk_hash(game->world_seed, cx, cz, -1) % (unsigned int)(cubes + 1));
+    for (k = 0; k < CHUNK_CUBES_MAX; k++) {
+        obs[k].active = 0;
+        // No new cubes after the game is won, and none right where the game starts
+        if (k >= count || game->show_Win_Screen || cube_killed(game, cx, cz, k)) continue;
+        wx = (cx + (chunk_hash(game->world_seed, cx, cz, k * 4) % 1024u) / 1024.0) * CHUNK_SIZE;
+        wz = (cz + (chunk_hash(game->world_seed, cx, cz, k * 4 + 1) % 1024u) / 1024.0) * CHUNK_SIZE;
+        if (wx * wx + wz * wz < START_CLEAR * START_CLEAR) continue;
+        
+        obs[k].active = 1;
+        obs[k].position.x = wx - game->origin_x;
+        obs[k].position.z = wz - game->origin_z;
+        obs[k].position.y = get_terrain_height(game, obs[k].position.x, obs[k].position.z)
+                            + 30 + chunk_hash(game->world_seed, cx, cz, k * 4 + 2) % 100;  // More height variation
+        obs[k].size = 30 + chunk_hash(game->world_seed, cx, cz, k * 4 + 3) % 30;
+        obs[k].rotation = fmod(0.02 * game->tick, 2.0 * PI); // spinning in step with the cubes already loaded
+    }
+}
+
+// Load the chunks around the camera that are not loaded yet
+// Costs nothing until the camera crosses into another chunk
+void stream_chunks(GameState *game) {
+    ChunkTable *t = &game->chunks;
+    int cx = (int)floor((game->origin_x + game->camera.position.x) / CHUNK_SIZE);
+    int cz = (int)floor((game->origin_z + game->camera.position.z) / CHUNK_SIZE);
+    int x, z, slot, i;
+    
+    if (t->ready && cx == t->centre_x && cz == t->centre_z) return;
+    t->centre_x = cx;
+    t->centre_z = cz;
+    t->ready = 1;
+    for (x = cx - CHUNK_RADIUS; x <= cx + CHUNK_RADIUS; x++) {
+        for (z = cz - CHUNK_RADIUS; z <= cz + CHUNK_RADIUS; z++) {
+            slot = chunk_slot(x, z);
+            if (t->loaded[slot] && t->cx[slot] == x && t->cz[slot] == z) continue;
+            load_chunk(game, x, z);
+        }
+    }
+    
+    t->live_count = 0;
+    for (i = 0; i < MAX_OBSTACLES; i++) {
+        if (game->obstacles[i].active) t->live[t->live_count++] = (short)i;
+    }
+}
+
+// Forget every loaded chunk and place them all again (new game, or after a rewind
+// put back a different seed, kill list and origin)
+void reload_chunks(GameState *game) {
+    memset(&game->chunks, 0, sizeof(game->chunks));
+    stream_chunks(game);
+}
+
+// Spin the cubes and stream in the chunks the camera is flying toward
+void update_obstacles(GameState *game) {
+    int i;
+    
+    game->tick++;
+    for (i = 0; i < game->chunks.live_count; i++) {
+        game->obstacles[game->chunks.live[i]].rotation += 0.02; // rotate obstacle (shot ones too, nobody sees them)
+    }
+    stream_chunks(game);
+}
+
+// Blow an obstacle into debris, the pieces die when they fall below the ground
+// under the cube
+void spawn_debris(GameState *game, Obstacle *obs, int count, float speed) {
+    real ground = get_terrain_height(game, obs->position.x, obs->position.z);
+    
+    particles_spawn(&game->particles, obs->position.x, obs->position.y, obs->position.z,
+                    ground, count, speed);
+}
+
+/* ==================== BULLETS ==================== */
+
+// Fire a new bullet from camera position
+void fire_bullet(GameState *game) {
+    int i;
+    Bullet *b;
+    Camera *cam = &game->camera;
+    
+    // Find inactive bullet slot
+    for (i = 0; i < MAX_BULLETS; i++) {
+        if (!game->bullets[i].active) {
+            b = &game->bullets[i];
+            b->active = 1;
+            b->position = cam->position;
+            // Use cached trig values
+            b->velocity.x = BULLET_SPEED * cam->sin_yaw * cam->cos_pitch; // set x velocity
+            b->velocity.y = BULLET_SPEED * cam->sin_pitch; // set y velocity
+            b->velocity.z = BULLET_SPEED * cam->cos_yaw * cam->cos_pitch; // set z velocity
+            return;
+        }
+    }
+}
+
+// Update bullet positions and deactivate if out of range
+void update_bullets(GameState *game) {
+    int i;
+    real dx, dy, dz, distSq;
+    Bullet *b;
+    // Update each active bullet
+    for (i = 0; i < MAX_BULLETS; i++) {
+        b = &game->bullets[i];
+        if (b->active) {
+            b->position.x += b->velocity.x;
+            b->position.y += b->velocity.y;
+            b->position.z += b->velocity.z;
+            
+            /* Check distance from camera */
+            dx = b->position.x - game->camera.position.x;
+            dy = b->position.y - game->camera.position.y;
+            dz = b->position.z - game->camera.position.z;
+            distSq = dx*dx + dy*dy + dz*dz;
+            
+            if (distSq > RENDER_DISTANCE * RENDER_DISTANCE * 2) {
+                b->active = 0;
+            }
+            
+            /* Check if hit ground */
+            if (b->position.y < get_terrain_height(game, b->position.x, b->position.z)) {
+                b->active = 0;
+            }
+        }
+    }
+}
+
+// Check for collisions between bullets, obstacles, and player
+void check_collisions(GameState *game) {
+    int i, j, n;
+    real dx, dy, dz, distSq, hitDist;
+    
+    // Check bullet-obstacle collisions
+    for (i = 0; i < MAX_BULLETS; i++) {
+        if (!game->bullets[i].active) continue;
+        
+        // Check against all obstacles of the loaded chunks
+        for (n = 0; n < game->chunks.live_count; n++) {
+            j = game->chunks.live[n];
+            if (!game->obstacles[j].active) continue;
+            game->counters.collision_tests++;
+            
+            // Calculate squared distance
+            dx = game->bullets[i].position.x - game->obstacles[j].position.x;
+            dy = game->bullets[i].position.y - game->obstacles[j].position.y;
+            dz = game->bullets[i].position.z - game->obstacles[j].position.z;
+            distSq = dx*dx + dy*dy + dz*dz;
+            
+            hitDist = game->obstacles[j].size * game->tuning.hit_scale; // hit distance based on obstacle size
+            
+            if (distSq < hitDist * hitDist) {
+                game->bullets[i].active = 0;
+                game->obstacles[j].active = 0;
+                record_kill(game, j);
+                game->score += 100;
+                game->events.hits++;
+                spawn_debris(game, &game->obstacles[j], HIT_DEBRIS, 4.0f);
+            }
+        }
+    }
+    
+    //Check player-obstacle collisions (lose a life)
+    for (n = 0; n < game->chunks.live_count; n++) {
+        j = game->chunks.live[n];
+        if (!game->obstacles[j].active) continue;
+        game->counters.collision_tests++;
+        
+        dx = game->camera.position.x - game->obstacles[j].position.x;
+        dy = game->camera.position.y - game->obstacles[j].position.y;
+        dz = game->camera.position.z - game->obstacles[j].position.z;
+        distSq = dx*dx + dy*dy + dz*dz;
+        
+        hitDist = game->obstacles[j].size + game->tuning.player_radius;  /* Player collision radius */
+        
+        if (distSq < hitDist * hitDist) {
+            game->obstacles[j].active = 0;  /* Destroy the obstacle */
+            record_kill(game, j);
+            spawn_debris(game, &game->obstacles[j], CRASH_DEBRIS, 2.5f);
+            game->lives--;
+            game->events.collisions++;
+            
+            if (game->lives <= 0) {
+                game->game_over = 1;
+            }
+        }
+    }
+}
+
+/* ==================== SNAPSHOTS ==================== */
+// Every SNAPSHOT_EVERY frames the start of GameState (everything up to hidden_lines,
+// random number state included) is copied into a ring, rewinding copies one back.
+// It is one memcpy of a fixed size either way, however far into the game we are.
+
+// Empty ring, cost totals zeroed (once at startup, this also touches all its memory)
+void snapshot_init(SnapshotRing *ring) {
+    memset(ring, 0, sizeof(*ring));
+}
+
+// Forget all snapshots (new game), the cost totals keep counting
+void snapshot_reset(SnapshotRing *ring) {
+    ring->count = 0;
+    ring->next = 0;
+    ring->since = 0;
+}
+
+// Call once per played frame, takes a snapshot every SNAPSHOT_EVERY frames
+// (and right away when the ring is empty)
+void snapshot_frame(SnapshotRing *ring, GameState *game) {
+    double t0;
+    
+    if (ring->count > 0 && ++ring->since < SNAPSHOT_EVERY) return;
+    ring->since = 0;
+    t0 = now_seconds();
+    memcpy(ring->state[ring->next], game, SNAPSHOT_SIZE);
+    ring->next = (ring->next + 1) % SNAPSHOTS;
+    if (ring->count < SNAPSHOTS) ring->count++;
+    ring->taken++;
+    ring->seconds += now_seconds() - t0;
+}
+
+// Go back to the snapshot steps before the newest one (or the oldest we have)
+// The newer ones are dropped, so pressing rewind again keeps going back
+// Returns how many snapshots back it went, -1 if there are none
+int snapshot_rewind(SnapshotRing *ring, GameState *game, int steps) {
+    int slot;
+    
+    if (ring->count == 0) return -1;
+    if (steps > ring->count - 1) steps = ring->count - 1;
+    slot = (ring->next - 1 - steps + 2 * SNAPSHOTS) % SNAPSHOTS;
+    memcpy(game, ring->state[slot], SNAPSHOT_SIZE);
+    memset(&game->events, 0, sizeof(game->events));
+    particles_init(&game->particles); // debris is not saved, start clean
+    reload_chunks(game); // neither are the cubes, the seed and kill list put them back
+    
+    ring->count -= steps;
+    ring->next = (slot + 1) % SNAPSHOTS;
+    ring->since = 0; // we are at a snapshot now
+    return steps;
+}